@@ -16,6 +16,8 @@
 #include <type_traits>
 #include <algorithm>
 #include <fstream>
+#include <chrono>
+#include <limits>
 #include "board.h"
 #include "action.h"
 #include "weight.h"
@@ -80,45 +82,280 @@ public:
 			load_weights(meta["load"]);
 		if (meta.find("alpha") != meta.end())
 			alpha = float(meta["alpha"]);
+		if (meta.find("expect") != meta.end()) // learn from the expectation over all placer outcomes instead of the sampled one
+			expect = int(meta["expect"]);
+		if (meta.find("speed") != meta.end()) // the slider moves per second to sustain, e.g., the limit of threes-judge
+			budget = 1000000.0 / double(meta["speed"]);
+		if (meta.find("latency") != meta.end()) // the average time per move, in microseconds
+			budget = double(meta["latency"]);
+		if (meta.find("depth") != meta.end())
+			max_depth = std::min(std::max(int(meta["depth"]), 1), int(cost.size()) - 1);
+		if (meta.find("margin") != meta.end())
+			margin = double(meta["margin"]);
+		if (meta.find("carry") != meta.end()) // the slack carried to later moves, in budgets
+			carry = std::max(double(meta["carry"]), 0.0);
 	}
 	virtual ~tuple_agent() {
 		if (meta.find("save") != meta.end())
 			save_weights(meta["save"]);
 	}
 
+	virtual void notify(const std::string& msg){
+		agent::notify(msg);
+		if(msg.find("alpha=") == 0){
+			alpha = float(meta["alpha"]);
+		}
+	}
+
 	virtual action take_action(const board& before){
+		if(budget > 0){
+			return take_governed_action(before);
+		}
+		return take_actions({ before }, { lane }).front();
+	}
+
+	/**
+	 * select an action by an expectimax search whose depth is governed by the speed limit
+	 * the time of each depth is tracked by a moving average, and the deepest one predicted to fit
+	 * into the budget of this move plus the slack saved (or minus the debt owed) by the previous moves is searched,
+	 * so that the average time per move stays within margin * budget while the spare time goes into deeper searches
+	 * the slack is capped at carry budgets, so no single move may take more than (carry + 1) budgets after cheap moves
+	 */
+	action take_governed_action(const board& before){
+		double allowed = budget * margin + slack;
+		int depth = 1;
+		while(depth < max_depth && predict(depth + 1) <= allowed){
+			depth++;
+		}
+
+		auto start = std::chrono::steady_clock::now();
 		int best_op = -1;
 		int best_reward = -1;
 		float best_value = -1000000;
-
 		board best_after;
-
 		for(int op = 0; op <= 3; op++){
-
 			board after = before;
 			int reward = after.slide(op);
-
 			if(reward == -1){
 				continue;
 			}
-
-			float value = calculate_value(after);
-
+			float value = expect_value(after, depth - 1);
 			if((reward + value) > (best_reward + best_value)){
 				best_op = op;
-				best_after = after;
 				best_value = value;
 				best_reward = reward;
+				best_after = after;
 			}
 		}
+		std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+		slack = std::min(slack + budget * margin - elapsed.count(), budget * margin * carry);
+		cost[depth] = cost[depth] ? cost[depth] * 0.9 + elapsed.count() * 0.1 : elapsed.count();
 
 		if(best_op != -1){
 			record.push_back({best_reward, best_after});
 		}
-
 		return action::slide(best_op);
 	}
 
+	/**
+	 * the predicted time of a move searching (depth) slides ahead, in microseconds
+	 * a depth not yet measured is guessed from the one above it, assuming a branching factor of 16
+	 */
+	double predict(int depth) const{
+		if(cost[depth]){
+			return cost[depth];
+		}
+		return cost[depth - 1] ? cost[depth - 1] * 16 : std::numeric_limits<double>::infinity();
+	}
+
+	/**
+	 * the expected value of an afterstate looking (depth) slides ahead,
+	 * averaged over the positions the placer may use and the hints it may draw from the bag
+	 */
+	float expect_value(const board& after, int depth) const{
+		if(depth == 0){
+			return calculate_value(after);
+		}
+		std::vector<std::pair<board, unsigned>> outcomes = placements(after);
+		float total = 0;
+		unsigned weight = 0;
+		for(const std::pair<board, unsigned>& placed : outcomes){
+			float best = 0; // the game is over if no slide is legal
+			for(int op = 0; op <= 3; op++){
+				board next = placed.first;
+				int reward = next.slide(op);
+				if(reward != -1){
+					best = std::max(best, reward + expect_value(next, depth - 1));
+				}
+			}
+			total += best * placed.second;
+			weight += placed.second;
+		}
+		return weight ? total / weight : calculate_value(after);
+	}
+
+	/**
+	 * all the boards the placer may produce from an afterstate, each with its weight, i.e.,
+	 * every empty position on the edge opposite to the last slide, times every hint left in the bag (weighted by its count)
+	 * the tile placed is the current hint, so an afterstate without a hint has no outcome
+	 */
+	static std::vector<std::pair<board, unsigned>> placements(const board& after){
+		static const std::array<std::array<int, 4>, 4> edges = {{
+			{{12, 13, 14, 15}}, {{0, 4, 8, 12}}, {{0, 1, 2, 3}}, {{3, 7, 11, 15}},
+		}};
+		std::vector<std::pair<board, unsigned>> outcomes;
+		if(after.hint() == 0 || after.last() > 3){
+			return outcomes;
+		}
+		for(int pos : edges[after.last()]){
+			for(board::cell hint = 1; hint <= 3; hint++){
+				board placed = after;
+				if(placed.place(pos, after.hint(), hint) != -1){
+					outcomes.emplace_back(placed, after.bag(hint));
+				}
+			}
+		}
+		return outcomes;
+	}
+
+	/**
+	 * the TD target of an afterstate averaged over all the outcomes of the placer, i.e.,
+	 * the weighted mean of max(reward + value) over the slides after each outcome, where an outcome without a legal slide is worth 0
+	 * the slides of all outcomes are evaluated in one batch
+	 * return false if the afterstate has no outcome to average over
+	 */
+	bool expected_target(const board& after, float& target) const{
+		std::vector<std::pair<board, unsigned>> outcomes = placements(after);
+		if(outcomes.empty()){
+			return false;
+		}
+		std::vector<board> placed(outcomes.size()), next;
+		std::vector<int> reward;
+		std::vector<float> value;
+		for(size_t n = 0; n < outcomes.size(); n++){
+			placed[n] = outcomes[n].first;
+		}
+		evaluate_slides(placed, next, reward, value);
+
+		float total = 0;
+		unsigned weight = 0;
+		for(size_t n = 0; n < outcomes.size(); n++){
+			float best = 0;
+			for(size_t i = n * 4; i < n * 4 + 4; i++){
+				if(reward[i] != -1){
+					best = std::max(best, reward[i] + value[i]);
+				}
+			}
+			total += best * outcomes[n].second;
+			weight += outcomes[n].second;
+		}
+		target = total / weight;
+		return true;
+	}
+
+	/**
+	 * slide every board of before in all 4 directions and evaluate the afterstates,
+	 * where after[i], reward[i], and value[i] are of before[i / 4] sliding toward i % 4 (reward[i] is -1 if illegal)
+	 * the lookups of all afterstates are prefetched first and resolved afterwards,
+	 * so that the cache misses of the weight tables overlap instead of being paid one after another
+	 */
+	void evaluate_slides(const std::vector<board>& before, std::vector<board>& after, std::vector<int>& reward, std::vector<float>& value) const{
+		size_t num = before.size();
+		std::vector<size_t> index(num * 4 * tuples);
+		after.resize(num * 4);
+		reward.resize(num * 4);
+		value.assign(num * 4, 0);
+
+		for(size_t i = 0; i < num * 4; i++){
+			after[i] = before[i / 4];
+			reward[i] = after[i].slide(i % 4);
+			if(reward[i] == -1){
+				continue;
+			}
+			get_indexes(after[i], &index[i * tuples]);
+			for(size_t t = 0; t < tuples; t++){
+				__builtin_prefetch(&table(t)[index[i * tuples + t]]);
+			}
+		}
+
+		for(size_t i = 0; i < num * 4; i++){
+			if(reward[i] == -1){
+				continue;
+			}
+			for(size_t t = 0; t < tuples; t++){
+				value[i] += table(t)[index[i * tuples + t]];
+			}
+		}
+	}
+
+	/**
+	 * select the actions for a group of independent games in lockstep
+	 * the afterstates of all games are evaluated in one batch by evaluate_slides
+	 * the afterstate of before[i] is recorded in lanes[i]
+	 */
+	std::vector<action> take_actions(const std::vector<board>& before, const std::vector<size_t>& lanes){
+		size_t num = before.size();
+		if(budget > 0){ // each move is governed on its own, since the depth is chosen per move
+			std::vector<action> moves;
+			for(size_t n = 0; n < num; n++){
+				switch_lane(lanes[n]);
+				moves.push_back(take_governed_action(before[n]));
+			}
+			return moves;
+		}
+		std::vector<board> after;
+		std::vector<int> reward;
+		std::vector<float> value;
+		evaluate_slides(before, after, reward, value);
+
+		std::vector<action> moves;
+		moves.reserve(num);
+		for(size_t n = 0; n < num; n++){
+			int best_op = -1;
+			int best_reward = -1;
+			float best_value = -1000000;
+
+			for(int op = 0; op <= 3; op++){
+				size_t i = n * 4 + op;
+
+				if(reward[i] == -1){
+					continue;
+				}
+
+				if((reward[i] + value[i]) > (best_reward + best_value)){
+					best_op = op;
+					best_value = value[i];
+					best_reward = reward[i];
+				}
+			}
+
+			if(best_op != -1){
+				switch_lane(lanes[n]);
+				record.push_back({best_reward, after[n * 4 + best_op]});
+			}
+
+			moves.push_back(action::slide(best_op));
+		}
+		return moves;
+	}
+
+	/**
+	 * switch the in-flight episode used by take_action and close_episode,
+	 * so that several games can be interleaved with a single agent
+	 */
+	void switch_lane(size_t i){
+		if(parked.size() <= std::max(i, lane)){
+			parked.resize(std::max(i, lane) + 1);
+		}
+		if(i == lane){
+			return;
+		}
+		std::swap(record, parked[lane]);
+		std::swap(record, parked[i]);
+		lane = i;
+	}
+
 	virtual void open_episode(const std::string& flag = ""){
 		record.clear();
 	}
@@ -132,6 +369,17 @@ public:
 			return;
 		}
 
+		if(expect){
+			for(int i = record.size() - 1; i >= 0; i--){
+				float adjust_target = 0;
+				if(!expected_target(record[i].after, adjust_target) && i + 1 < int(record.size())){
+					adjust_target = record[i+1].reward + calculate_value(record[i+1].after);
+				}
+				adjust_value(record[i].after, adjust_target);
+			}
+			return;
+		}
+
 		adjust_value(record[record.size() - 1].after, 0);
 
 		for(int i = record.size() - 2; i >= 0; i--){
@@ -146,6 +394,8 @@ public:
 	};
 
 	std::vector<step> record;
+	std::vector<std::vector<step>> parked; // records of the other in-flight episodes
+	size_t lane = 0;
 
 	// 4 x 8 Tuple
 	//
@@ -190,67 +440,68 @@ public:
 		return after(vertice1) * 16 * 16 * 16 * 16 * 16 + after(vertice2) * 16 * 16 * 16 * 16 + after(vertice3) * 16 * 16 * 16 + after(vertice4) * 16 * 16 + after(vertice5) * 16 + after(vertice6);
 	}
 
-	float calculate_value(const board& after) const{
-		float value = 0;
+	static constexpr size_t tuples = 32;
+
+	// the cells of each tuple, in the order of net[0..7], net2[0..7], net3[0..7], net4[0..7]
+	static const std::array<std::array<int, 6>, tuples>& patterns(){
+		static const std::array<std::array<int, 6>, tuples> cells = {{
+			// OO
+			// OO
+			// OO
+			//
+			{{0, 1, 2, 4, 5, 6}}, {{1, 2, 3, 5, 6, 7}}, {{8, 9, 10, 12, 13, 14}}, {{9, 10, 11, 13, 14, 15}},
+			{{0, 1, 4, 5, 8, 9}}, {{2, 3, 6, 7, 10, 11}}, {{4, 5, 8, 9, 12, 13}}, {{6, 7, 10, 11, 14, 15}},
+
+			// OO
+			// OO
+			// OO (at mid)
+			//
+			{{1, 2, 5, 6, 9, 10}}, {{5, 6, 9, 10, 13, 14}}, {{4, 5, 6, 8, 9, 10}}, {{5, 6, 7, 9, 10, 11}},
+			{{1, 2, 5, 6, 9, 10}}, {{5, 6, 9, 10, 13, 14}}, {{4, 5, 6, 8, 9, 10}}, {{5, 6, 7, 9, 10, 11}},
+
+			// OO
+			// OO
+			// O
+			// O
+			//
+			{{0, 1, 4, 5, 8, 12}}, {{0, 1, 2, 3, 6, 7}}, {{3, 7, 10, 11, 14, 15}}, {{8, 9, 12, 13, 14, 15}},
+			{{0, 4, 8, 9, 12, 13}}, {{10, 11, 12, 13, 14, 15}}, {{2, 3, 6, 7, 11, 15}}, {{0, 1, 2, 3, 4, 5}},
+
+			// OO
+			// OO
+			// O
+			// O  (at mid)
+			//
+			{{1, 2, 5, 6, 9, 13}}, {{4, 5, 6, 7, 10, 11}}, {{2, 6, 9, 10, 13, 14}}, {{4, 5, 8, 9, 10, 11}},
+			{{1, 5, 9, 10, 13, 14}}, {{6, 7, 8, 9, 10, 11}}, {{1, 2, 5, 6, 10, 14}}, {{4, 5, 6, 7, 8, 9}},
+		}};
+		return cells;
+	}
+
+	const weight& table(size_t t) const{
+		const std::vector<weight>& nets = t < 8 ? net : t < 16 ? net2 : t < 24 ? net3 : net4;
+		return nets[t % 8];
+	}
+	weight& table(size_t t){
+		std::vector<weight>& nets = t < 8 ? net : t < 16 ? net2 : t < 24 ? net3 : net4;
+		return nets[t % 8];
+	}
+
+	void get_indexes(const board& after, size_t* index) const{
+		for(size_t t = 0; t < tuples; t++){
+			const std::array<int, 6>& p = patterns()[t];
+			index[t] = get_feature(after, p[0], p[1], p[2], p[3], p[4], p[5]);
+		}
+	}
 
-		// OO
-		// OO
-		// OO
-		//
-		value += net[0][get_feature(after, 0, 1, 2, 4, 5, 6)];
-		value += net[1][get_feature(after, 1, 2, 3, 5, 6, 7)];
-		value += net[2][get_feature(after, 8, 9, 10, 12, 13, 14)];
-		value += net[3][get_feature(after, 9, 10, 11, 13, 14, 15)];
-
-		value += net[4][get_feature(after, 0, 1, 4, 5, 8, 9)];
-		value += net[5][get_feature(after, 2, 3, 6, 7, 10, 11)];
-		value += net[6][get_feature(after, 4, 5, 8, 9, 12, 13)];
-		value += net[7][get_feature(after, 6, 7, 10, 11, 14, 15)];
-
-		// OO
-		// OO
-		// OO (at mid)
-		//
-		value += net2[0][get_feature(after, 1, 2, 5, 6, 9, 10)];
-		value += net2[1][get_feature(after, 5, 6, 9, 10, 13, 14)];
-		value += net2[2][get_feature(after, 4, 5, 6, 8, 9, 10)];
-		value += net2[3][get_feature(after, 5, 6, 7, 9, 10, 11)];
-
-		value += net2[4][get_feature(after, 1, 2, 5, 6, 9, 10)];
-		value += net2[5][get_feature(after, 5, 6, 9, 10, 13, 14)];
-		value += net2[6][get_feature(after, 4, 5, 6, 8, 9, 10)];
-		value += net2[7][get_feature(after, 5, 6, 7, 9, 10, 11)];
-
-		// OO
-		// OO
-		// O
-		// O
-		//
-		value += net3[0][get_feature(after, 0, 1, 4, 5, 8, 12)];
-		value += net3[1][get_feature(after, 0, 1, 2, 3, 6, 7)];
-		value += net3[2][get_feature(after, 3, 7, 10, 11, 14, 15)];
-		value += net3[3][get_feature(after, 8, 9, 12, 13, 14, 15)];
-
-		value += net3[4][get_feature(after, 0, 4, 8, 9, 12, 13)];
-		value += net3[5][get_feature(after, 10, 11, 12, 13, 14, 15)];
-		value += net3[6][get_feature(after, 2, 3, 6, 7, 11, 15)];
-		value += net3[7][get_feature(after, 0, 1, 2, 3, 4, 5)];
-
-		// OO
-		// OO
-		// O
-		// O  (at mid)
-		//
-		value += net4[0][get_feature(after, 1, 2, 5, 6, 9, 13)];
-		value += net4[1][get_feature(after, 4, 5, 6, 7, 10, 11)];
-		value += net4[2][get_feature(after, 2, 6, 9, 10, 13, 14)];
-		value += net4[3][get_feature(after, 4, 5, 8, 9, 10, 11)];
-
-		value += net4[4][get_feature(after, 1, 5, 9, 10, 13, 14)];
-		value += net4[5][get_feature(after, 6, 7, 8, 9, 10, 11)];
-		value += net4[6][get_feature(after, 1, 2, 5, 6, 10, 14)];
-		value += net4[7][get_feature(after, 4, 5, 6, 7, 8, 9)];
+	float calculate_value(const board& after) const{
+		size_t index[tuples];
+		get_indexes(after, index);
 
+		float value = 0;
+		for(size_t t = 0; t < tuples; t++){
+			value += table(t)[index[t]];
+		}
 		return value;
 	}
 
@@ -259,48 +510,11 @@ public:
 		float offset = target - current;
 		float adjust = alpha * offset;
 
-		net[0][get_feature(after, 0, 1, 2, 4, 5, 6)] += adjust;
-		net[1][get_feature(after, 1, 2, 3, 5, 6, 7)] += adjust;
-		net[2][get_feature(after, 8, 9, 10, 12, 13, 14)] += adjust;
-		net[3][get_feature(after, 9, 10, 11, 13, 14, 15)] += adjust;
-
-		net[4][get_feature(after, 0, 1, 4, 5, 8, 9)] += adjust;
-		net[5][get_feature(after, 2, 3, 6, 7, 10, 11)] += adjust;
-		net[6][get_feature(after, 4, 5, 8, 9, 12, 13)] += adjust;
-		net[7][get_feature(after, 6, 7, 10, 11, 14, 15)] += adjust;
-
-
-		net2[0][get_feature(after, 1, 2, 5, 6, 9, 10)] += adjust;
-		net2[1][get_feature(after, 5, 6, 9, 10, 13, 14)] += adjust;
-		net2[2][get_feature(after, 4, 5, 6, 8, 9, 10)] += adjust;
-		net2[3][get_feature(after, 5, 6, 7, 9, 10, 11)] += adjust;
-
-		net2[4][get_feature(after, 1, 2, 5, 6, 9, 10)] += adjust;
-		net2[5][get_feature(after, 5, 6, 9, 10, 13, 14)] += adjust;
-		net2[6][get_feature(after, 4, 5, 6, 8, 9, 10)] += adjust;
-		net2[7][get_feature(after, 5, 6, 7, 9, 10, 1)] += adjust;
-
-
-		net3[0][get_feature(after, 0, 1, 4, 5, 8, 12)] += adjust;
-		net3[1][get_feature(after, 0, 1, 2, 3, 6, 7)] += adjust;
-		net3[2][get_feature(after, 3, 7, 10, 11, 14, 15)] += adjust;
-		net3[3][get_feature(after, 8, 9, 12, 13, 14, 15)] += adjust;
-
-		net3[4][get_feature(after, 0, 4, 8, 9, 12, 13)] += adjust;
-		net3[5][get_feature(after, 10, 11, 12, 13, 14, 15)] += adjust;
-		net3[6][get_feature(after, 2, 3, 6, 7, 11, 15)] += adjust;
-		net3[7][get_feature(after, 0, 1, 2, 3, 4, 5)] += adjust;
-
-
-		net4[0][get_feature(after, 1, 2, 5, 6, 9, 13)] += adjust;
-		net4[1][get_feature(after, 4, 5, 6, 7, 10, 11)] += adjust;
-		net4[2][get_feature(after, 2, 6, 9, 10, 13, 14)] += adjust;
-		net4[3][get_feature(after, 4, 5, 8, 9, 10, 11)] += adjust;
-
-		net4[4][get_feature(after, 1, 5, 9, 10, 13, 14)] += adjust;
-		net4[5][get_feature(after, 6, 7, 8, 9, 10, 11)] += adjust;
-		net4[6][get_feature(after, 1, 2, 5, 6, 10, 14)] += adjust;
-		net4[7][get_feature(after, 4, 5, 6, 7, 8, 9)] += adjust;
+		size_t index[tuples];
+		get_indexes(after, index);
+		for(size_t t = 0; t < tuples; t++){
+			table(t)[index[t]] += adjust;
+		}
 	}
 
 protected:
@@ -337,6 +551,15 @@ protected:
 	std::vector<weight> net3 {16777216, 16777216, 16777216, 16777216, 16777216, 16777216, 16777216, 16777216};
 	std::vector<weight> net4 {16777216, 16777216, 16777216, 16777216, 16777216, 16777216, 16777216, 16777216};
 	float alpha;
+	bool expect = false;
+
+	// the speed governor of take_governed_action, disabled if budget is 0
+	double budget = 0; // microseconds per move
+	double margin = 0.9; // the fraction of the budget to use, leaving room for the bookkeeping of the episodes
+	int max_depth = 3;
+	double carry = 4;
+	double slack = 0; // microseconds saved by the governed moves so far, or owed if negative
+	std::array<double, 16> cost = {}; // depth -> the moving average of the time per move, in microseconds
 };
 
 /**
@@ -345,36 +568,49 @@ protected:
  */
 class random_placer : public random_agent {
 public:
-	random_placer(const std::string& args = "") : random_agent("name=place role=placer " + args) {
-		spaces[0] = { 12, 13, 14, 15 };
-		spaces[1] = { 0, 4, 8, 12 };
-		spaces[2] = { 0, 1, 2, 3};
-		spaces[3] = { 3, 7, 11, 15 };
-		spaces[4] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
-	}
+	random_placer(const std::string& args = "") : random_agent("name=place role=placer " + args) {}
 
 	virtual action take_action(const board& after) {
-		std::vector<int> space = spaces[after.last()];
-		std::shuffle(space.begin(), space.end(), engine);
-		for (int pos : space) {
-			if (after(pos) != 0) continue;
+		unsigned pos;
+		board::cell tile, hint;
+		if (placement(after, engine, pos, tile, hint))
+			return action::place(pos, tile, hint);
+		return action();
+	}
+
+	/**
+	 * draw a placement for the afterstate from the random stream
+	 * the same draws give the same placement, which the batched environment (batch.h) relies on
+	 * return false if there is no empty position to place
+	 */
+	template<typename generator>
+	static bool placement(const board& after, generator& engine, unsigned& pos, board::cell& tile, board::cell& hint) {
+		static const std::array<std::array<int, 16>, 5> spaces = {{
+			{{ 12, 13, 14, 15 }},
+			{{ 0, 4, 8, 12 }},
+			{{ 0, 1, 2, 3 }},
+			{{ 3, 7, 11, 15 }},
+			{{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 }},
+		}};
+		std::array<int, 16> space = spaces[after.last()];
+		size_t size = after.last() < 4 ? 4 : 16;
+		std::shuffle(space.begin(), space.begin() + size, engine);
+		for (size_t i = 0; i < size; i++) {
+			if (after(space[i]) != 0) continue;
 
 			int bag[3], num = 0;
 			for (board::cell t = 1; t <= 3; t++)
-				for (size_t i = 0; i < after.bag(t); i++)
+				for (size_t n = 0; n < after.bag(t); n++)
 					bag[num++] = t;
 			std::shuffle(bag, bag + num, engine);
 
-			board::cell tile = after.hint() ?: bag[--num];
-			board::cell hint = bag[--num];
-
-			return action::place(pos, tile, hint);
+			pos = space[i];
+			tile = after.hint() ?: bag[--num];
+			hint = bag[--num];
+			return true;
 		}
-		return action();
+		return false;
 	}
-
-private:
-	std::vector<int> spaces[5];
 };
 
 /**
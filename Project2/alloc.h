@@ -0,0 +1,185 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * alloc.h: Opt-in accounting of heap allocations per thread and per phase
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+/**
+ * the accounting is enabled by building with -DALLOC_STATS, e.g., "make alloc", which replaces the global
+ * operator new and delete; otherwise the phases cost nothing and the reports print nothing
+ * since the operators are defined here, this header should be included only by the file with main()
+ *
+ * a phase is the name of what the calling thread is doing, set for a scope, e.g.,
+ *   allocation::phase scope("slide");
+ * each allocation is counted (count, bytes) in the current phase of the allocating thread,
+ * and each deallocation (frees) in the phase which made the allocation, but by the deallocating thread,
+ * so the live bytes of a phase are exact when summed over the threads, and the peak is of each thread
+ */
+class allocation {
+public:
+	enum { max_phases = 16, max_threads = 256 };
+
+	class phase {
+	public:
+#ifdef ALLOC_STATS
+		phase(const char* name) : last(self().current) { self().current = allocation::index(name); }
+		~phase() { self().current = last; }
+	private:
+		unsigned last;
+#else
+		phase(const char* name) {}
+#endif
+	};
+
+	/**
+	 * print the counters of each thread and phase since the last report, or since the start if total is true
+	 */
+	static void report(std::ostream& out, bool total = false) {
+#ifdef ALLOC_STATS
+		out << (total ? "allocations in total" : "allocations since the last report") << std::endl;
+		out << "\t" "thread" "\t" "phase" "\t" "allocs" "\t" "bytes" "\t" "frees" "\t" "peak" << std::endl;
+		unsigned threads = num_ledgers.load(), phases = num_phases.load();
+		for (unsigned t = 0; t < threads; t++) {
+			for (unsigned p = 0; p < phases; p++) {
+				counter& c = ledgers()[t]->phases[p];
+				counter& r = ledgers()[t]->reported[p];
+				uint64_t allocs = c.count.load(std::memory_order_relaxed), bytes = c.bytes.load(std::memory_order_relaxed);
+				uint64_t frees = c.frees.load(std::memory_order_relaxed);
+				if (!total) {
+					allocs -= r.count.exchange(allocs);
+					bytes -= r.bytes.exchange(bytes);
+					frees -= r.frees.exchange(frees);
+				}
+				if (allocs == 0 && frees == 0) continue;
+				out << "\t" << t << "\t" << names()[p] << "\t" << allocs << "\t" << bytes << "\t" << frees
+				    << "\t" << c.peak.load(std::memory_order_relaxed) << std::endl;
+			}
+		}
+		out << std::endl;
+#endif
+	}
+
+#ifdef ALLOC_STATS
+public:
+	static void* allocate(size_t size) {
+		ledger& self = allocation::self();
+		void* raw = std::malloc(size + header);
+		if (!raw) return nullptr;
+		unsigned p = self.current;
+		std::memcpy(raw, &size, sizeof(size));
+		std::memcpy(static_cast<char*>(raw) + sizeof(size), &p, sizeof(p));
+		counter& c = self.phases[p];
+		add(c.count, 1);
+		add(c.bytes, size);
+		int64_t live = c.live.load(std::memory_order_relaxed) + size;
+		c.live.store(live, std::memory_order_relaxed);
+		if (live > c.peak.load(std::memory_order_relaxed)) c.peak.store(live, std::memory_order_relaxed);
+		return static_cast<char*>(raw) + header;
+	}
+	static void deallocate(void* ptr) {
+		if (!ptr) return;
+		void* raw = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(ptr) - header);
+		size_t size;
+		unsigned p;
+		std::memcpy(&size, raw, sizeof(size));
+		std::memcpy(&p, static_cast<char*>(raw) + sizeof(size), sizeof(p));
+		counter& c = self().phases[p];
+		add(c.frees, 1);
+		c.live.store(c.live.load(std::memory_order_relaxed) - int64_t(size), std::memory_order_relaxed);
+		std::free(raw);
+	}
+
+protected:
+	enum { header = 16 }; // the size and the phase of each allocation, keeping the alignment of malloc
+
+	/**
+	 * the counters are written only by their own thread, and read by the reporting thread
+	 */
+	struct counter {
+		std::atomic<uint64_t> count, bytes, frees;
+		std::atomic<int64_t> live, peak;
+	};
+	struct ledger {
+		counter phases[max_phases];
+		counter reported[max_phases];
+		unsigned current;
+	};
+
+	static void add(std::atomic<uint64_t>& v, uint64_t n) { v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+	/**
+	 * the ledger of the calling thread, which is allocated by malloc and kept after the thread exits,
+	 * so that the threads which have finished still appear in the final report
+	 */
+	static ledger& self() {
+		static thread_local ledger* mine = nullptr;
+		if (!mine) {
+			unsigned t = num_ledgers.fetch_add(1);
+			if (t >= max_threads) std::abort();
+			mine = static_cast<ledger*>(std::calloc(1, sizeof(ledger)));
+			if (!mine) std::abort();
+			ledgers()[t] = mine;
+		}
+		return *mine;
+	}
+
+	/**
+	 * the index of a phase name, registering it at the first use
+	 */
+	static unsigned index(const char* name) {
+		for (unsigned p = 0, n = num_phases.load(); p < n; p++) {
+			if (std::strcmp(names()[p], name) == 0) return p;
+		}
+		static std::mutex lock;
+		std::lock_guard<std::mutex> guard(lock);
+		unsigned n = num_phases.load();
+		for (unsigned p = 0; p < n; p++) {
+			if (std::strcmp(names()[p], name) == 0) return p;
+		}
+		if (n >= max_phases) return 0;
+		names()[n] = name;
+		num_phases.store(n + 1);
+		return n;
+	}
+
+	static ledger** ledgers() { static ledger* list[max_threads] = {}; return list; }
+	static const char** names() { static const char* list[max_phases] = { "other" }; return list; }
+	static std::atomic<unsigned> num_ledgers, num_phases;
+#endif
+};
+
+void report_allocations(std::ostream& out) { allocation::report(out); }
+
+#ifdef ALLOC_STATS
+std::atomic<unsigned> allocation::num_ledgers(0);
+std::atomic<unsigned> allocation::num_phases(1);
+
+void* operator new(size_t size) {
+	void* ptr = allocation::allocate(size);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+void* operator new[](size_t size) {
+	void* ptr = allocation::allocate(size);
+	if (!ptr) throw std::bad_alloc();
+	return ptr;
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocation::allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocation::allocate(size); }
+void operator delete(void* ptr) noexcept { allocation::deallocate(ptr); }
+void operator delete[](void* ptr) noexcept { allocation::deallocate(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { allocation::deallocate(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { allocation::deallocate(ptr); }
+#endif
@@ -0,0 +1,121 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * batch.cpp: Throughput and consistency check of the batched environment
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "board.h"
+#include "agent.h"
+#include "batch.h"
+#include "threads.h"
+
+int main(int argc, const char* argv[]) {
+	std::cerr << "Threes-Batch: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cerr, " "));
+	std::cerr << std::endl << std::endl;
+
+	size_t games = 4096, steps = 1000, verify = 16;
+	unsigned seed = 0;
+	std::string threads = "auto", affinity, numa; // for worker threads
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto match_arg = [&](std::string flag) -> bool {
+			auto it = arg.find_first_not_of('-');
+			return arg.find(flag, it) == it;
+		};
+		auto next_opt = [&]() -> std::string {
+			auto it = arg.find('=') + 1;
+			return it ? arg.substr(it) : argv[++i];
+		};
+		if (match_arg("games")) {
+			games = std::max<size_t>(std::stoull(next_opt()), 1);
+		} else if (match_arg("steps")) {
+			steps = std::stoull(next_opt());
+		} else if (match_arg("seed")) {
+			seed = std::stoul(next_opt());
+		} else if (match_arg("verify")) { // the games replayed one by one to check the batched results
+			verify = std::stoull(next_opt());
+		} else if (match_arg("threads")) {
+			threads = next_opt();
+		} else if (match_arg("affinity")) {
+			affinity = next_opt();
+		} else if (match_arg("numa")) {
+			numa = next_opt();
+		}
+	}
+	verify = std::min(verify, games);
+
+	// the games are driven by a random legal slide, and restarted as soon as they are done
+	workers pool(threads, affinity, numa);
+	batch env(games, seed, pool);
+	std::default_random_engine policy(seed);
+	std::vector<unsigned> ops(games);
+	std::vector<std::vector<unsigned>> history(verify); // the slides of the first game of each verified lane
+	std::vector<bool> tracking(verify, true);
+	size_t finished = 0, mismatches = 0;
+	board::score total = 0;
+
+	// replay the slides of a verified lane with board and random_placer, and compare the state and the score
+	auto check = [&](size_t i) {
+		std::default_random_engine engine(seed + i);
+		board b;
+		board::score score = 0;
+		auto respond = [&]() {
+			unsigned pos;
+			board::cell tile, hint;
+			if (random_placer::placement(b, engine, pos, tile, hint)) score += b.place(pos, tile, hint);
+		};
+		for (int n = 0; n < 9; n++) respond();
+		for (unsigned op : history[i]) {
+			board::reward reward = b.slide(op);
+			if (reward == -1) break;
+			score += reward;
+			respond();
+		}
+		if (batch::pack(b) != env.boards()[i] || b.info() != env.infos()[i] || score != env.scores()[i]) {
+			std::cerr << "game " << i << " differs after " << history[i].size() << " slides" << std::endl;
+			mismatches++;
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t s = 0; s < steps; s++) {
+		for (size_t i = 0; i < games; i++) {
+			unsigned legal = env.moves()[i];
+			unsigned op = policy() % 4;
+			while (legal && !(legal & (1u << op))) op = (op + 1) % 4;
+			ops[i] = op;
+			if (i < verify && tracking[i]) history[i].push_back(op);
+		}
+		env.step(ops.data());
+		for (size_t i = 0; i < games; i++) {
+			if (!env.dones()[i]) continue;
+			if (i < verify && tracking[i]) {
+				check(i);
+				tracking[i] = false;
+			}
+			finished++;
+			total += env.scores()[i];
+			env.reset(i);
+		}
+	}
+	for (size_t i = 0; i < verify; i++) {
+		if (tracking[i]) check(i);
+	}
+	std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+	std::cout << "games = " << games << ", threads = " << pool.size() << ", steps = " << steps << std::endl;
+	std::cout << "slides per second = " << (games * steps / time.count()) << std::endl;
+	std::cout << "finished = " << finished << ", avg = " << (finished ? total / finished : 0) << std::endl;
+	std::cout << "verified = " << verify << ", mismatches = " << mismatches << std::endl;
+	return mismatches ? 1 : 0;
+}
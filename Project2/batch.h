@@ -0,0 +1,148 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * batch.h: Batched environment stepping many games at once
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <random>
+#include <cstdint>
+#include "board.h"
+#include "agent.h"
+#include "threads.h"
+
+/**
+ * N games of the slider against the random placer, kept as structure of arrays:
+ * the tiles of game i are packed into boards()[i], 4 bits per cell where cell k is at bits 4k to 4k+3,
+ * and its hint, last slide, and bag are in infos()[i], i.e., board::info()
+ *
+ * step(ops) slides game i toward ops[i] and lets the placer respond, by the same board::slide and board::place,
+ * and by random_placer::placement with the random stream of game i, so a game is the same as the one played by threes
+ * with a placer drawing from that stream; the games are split into one chunk per worker
+ *
+ * after a step, rewards()[i] is the reward of the slide (-1 if the slide is illegal, which ends the game),
+ * moves()[i] holds the legal slides of the new state as bits (1 << op), and dones()[i] is 1 if there is none
+ * a game which is done stays as it is (with reward 0) until it is reset
+ *
+ * the cells hold tile indexes up to 15 (i.e., 12288), the same limit as action::place
+ */
+class batch {
+public:
+	batch(size_t num, unsigned seed = 0, const workers& pool = workers()) : pool(pool),
+		tiles(num), attrs(num), reward(num), score(num), move(num), done(num), engine(num) {
+		for (size_t i = 0; i < num; i++) engine[i].seed(seed + i);
+		reset();
+	}
+
+public:
+	size_t size() const { return tiles.size(); }
+
+	const uint64_t* boards() const { return tiles.data(); }
+	const uint64_t* infos() const { return attrs.data(); }
+	const int* rewards() const { return reward.data(); }
+	const board::score* scores() const { return score.data(); }
+	const uint8_t* moves() const { return move.data(); }
+	const uint8_t* dones() const { return done.data(); }
+
+	board state(size_t i) const { return unpack(tiles[i], attrs[i]); }
+
+	/**
+	 * restart all the games, where the placer places the first 9 tiles
+	 */
+	void reset() {
+		pool.run([&](size_t id) {
+			for (size_t i = begin(id), n = begin(id + 1); i < n; i++) reset(i);
+		});
+	}
+
+	/**
+	 * restart game i, whose random stream continues from where it was
+	 */
+	void reset(size_t i) {
+		board b;
+		score[i] = 0;
+		for (int n = 0; n < 9; n++) score[i] += respond(b, engine[i]);
+		store(i, b);
+		reward[i] = 0;
+	}
+
+	/**
+	 * apply the slides ops[i] (0: up, 1: right, 2: down, 3: left) to the ongoing games, each followed by the placer
+	 */
+	void step(const unsigned* ops) {
+		pool.run([&](size_t id) {
+			for (size_t i = begin(id), n = begin(id + 1); i < n; i++) {
+				if (done[i]) {
+					reward[i] = 0;
+					continue;
+				}
+				board b = state(i);
+				reward[i] = b.slide(ops[i]);
+				if (reward[i] == -1) {
+					done[i] = 1;
+					move[i] = 0;
+					continue;
+				}
+				score[i] += reward[i];
+				score[i] += respond(b, engine[i]);
+				store(i, b);
+			}
+		});
+	}
+
+public:
+	static uint64_t pack(const board& b) {
+		uint64_t code = 0;
+		for (int k = 0; k < 16; k++) code |= uint64_t(b(k) & 0x0f) << (4 * k);
+		return code;
+	}
+	static board unpack(uint64_t code, uint64_t info) {
+		board b;
+		for (int k = 0; k < 16; k++) b(k) = (code >> (4 * k)) & 0x0f;
+		b.info(info);
+		return b;
+	}
+
+	/**
+	 * the legal slides of a state, as bits
+	 */
+	static uint8_t legal(const board& b) {
+		uint8_t ops = 0;
+		for (int op = 0; op < 4; op++) {
+			if (board(b).slide(op) != -1) ops |= 1 << op;
+		}
+		return ops;
+	}
+
+protected:
+	template<typename generator>
+	static board::reward respond(board& b, generator& engine) {
+		unsigned pos;
+		board::cell tile, hint;
+		if (!random_placer::placement(b, engine, pos, tile, hint)) return 0;
+		return b.place(pos, tile, hint);
+	}
+
+	void store(size_t i, const board& b) {
+		tiles[i] = pack(b);
+		attrs[i] = b.info();
+		move[i] = legal(b);
+		done[i] = move[i] == 0;
+	}
+
+	size_t begin(size_t id) const { return size() * id / pool.size(); }
+
+private:
+	workers pool;
+	std::vector<uint64_t> tiles;
+	std::vector<uint64_t> attrs;
+	std::vector<int> reward;
+	std::vector<board::score> score;
+	std::vector<uint8_t> move;
+	std::vector<uint8_t> done;
+	std::vector<std::default_random_engine> engine; // the random stream of each game, seeded by seed + i
+};
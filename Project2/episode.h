@@ -35,9 +35,15 @@ public:
 		ep_close = { tag, millisec() };
 	}
 	bool apply_action(action move) {
+		return apply_action(move, millisec() - ep_time);
+	}
+	/**
+	 * apply a move which is charged the given milliseconds, e.g., its share of a move decided for several games at once
+	 */
+	bool apply_action(action move, time_t spent) {
 		board::reward reward = move.apply(state());
 		if (reward == -1) return false;
-		ep_moves.emplace_back(move, reward, millisec() - ep_time);
+		ep_moves.emplace_back(move, reward, spent);
 		ep_score += reward;
 		return true;
 	}
@@ -95,6 +101,33 @@ public:
 		return res;
 	}
 
+	/**
+	 * the time spent by each move, in the same order as actions()
+	 */
+	std::vector<time_t> times(unsigned who = -1u) const {
+		std::vector<time_t> res;
+		size_t i = 9;
+		switch (who) {
+		case action::place::type:
+			if (ep_moves.size())
+				for (i = 0; i < 8; i++) res.push_back(ep_moves[i].time);
+			// no break;
+		case action::slide::type:
+			while (i < ep_moves.size()) res.push_back(ep_moves[i].time), i += 2;
+			break;
+		default:
+			for (const move& mv : ep_moves) res.push_back(mv.time);
+			break;
+		}
+		return res;
+	}
+
+	/**
+	 * the tags given when the episode is opened and closed, e.g., the names of the players and the winner
+	 */
+	const std::string& open_tag() const { return ep_open.tag; }
+	const std::string& close_tag() const { return ep_close.tag; }
+
 public:
 
 	friend std::ostream& operator <<(std::ostream& out, const episode& ep) {
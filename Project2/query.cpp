@@ -0,0 +1,187 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * query.cpp: Parallel analytics over the episodes saved by --save
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <algorithm>
+#include "board.h"
+#include "action.h"
+#include "episode.h"
+#include "archive.h"
+#include "threads.h"
+
+/**
+ * the aggregations over the selected episodes, one per worker, merged at the end
+ */
+struct summary {
+	size_t episodes = 0;
+	board::score score_sum = 0;
+	board::score score_max = 0;
+	std::array<size_t, 32> tiles = {}; // the largest tile (index) -> games
+	std::map<size_t, std::array<size_t, 32>> blocks; // block -> the largest tile (index) -> games
+	std::map<size_t, board::score> block_scores; // block -> the sum of scores
+	std::map<size_t, size_t> scores; // bin -> games
+	std::map<size_t, size_t> lengths; // bin -> games
+	std::array<size_t, 4> slides = {}; // up, right, down, left
+	std::array<std::vector<time_t>, 2> times; // slider, placer
+
+	void add(size_t index, const episode& ep, size_t block, size_t bin, size_t steps) {
+		unsigned tile = std::min(*std::max_element(ep.state().begin(), ep.state().end()), 31u);
+		episodes++;
+		score_sum += ep.score();
+		score_max = std::max(score_max, ep.score());
+		tiles[tile]++;
+		blocks[index / block][tile]++;
+		block_scores[index / block] += ep.score();
+		scores[ep.score() / bin]++;
+		lengths[ep.step(action::slide::type) / steps]++;
+		for (const action& a : ep.actions(action::slide::type)) {
+			if (a.type() == action::slide::type) slides[a.event() & 0b11]++;
+		}
+		std::vector<time_t> slide = ep.times(action::slide::type), place = ep.times(action::place::type);
+		times[0].insert(times[0].end(), slide.begin(), slide.end());
+		times[1].insert(times[1].end(), place.begin(), place.end());
+	}
+
+	void merge(const summary& s) {
+		episodes += s.episodes;
+		score_sum += s.score_sum;
+		score_max = std::max(score_max, s.score_max);
+		for (size_t t = 0; t < tiles.size(); t++) tiles[t] += s.tiles[t];
+		for (const auto& p : s.blocks) {
+			for (size_t t = 0; t < p.second.size(); t++) blocks[p.first][t] += p.second[t];
+		}
+		for (const auto& p : s.block_scores) block_scores[p.first] += p.second;
+		for (const auto& p : s.scores)  scores[p.first] += p.second;
+		for (const auto& p : s.lengths) lengths[p.first] += p.second;
+		for (size_t i = 0; i < slides.size(); i++) slides[i] += s.slides[i];
+		for (size_t c = 0; c < 2; c++) times[c].insert(times[c].end(), s.times[c].begin(), s.times[c].end());
+	}
+};
+
+int main(int argc, const char* argv[]) {
+	std::cerr << "Threes-Query: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cerr, " "));
+	std::cerr << std::endl << std::endl;
+
+	std::string archive_path, json_path, tag;
+	size_t first = 1, last = -1, block = 1000, bin = 1000, steps = 100;
+	std::string threads = "auto", affinity, numa; // for worker threads
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto match_arg = [&](std::string flag) -> bool {
+			auto it = arg.find_first_not_of('-');
+			return arg.find(flag, it) == it;
+		};
+		auto next_opt = [&]() -> std::string {
+			auto it = arg.find('=') + 1;
+			return it ? arg.substr(it) : argv[++i];
+		};
+		if (match_arg("archive") || match_arg("load")) {
+			archive_path = next_opt();
+		} else if (match_arg("json")) {
+			json_path = next_opt();
+		} else if (match_arg("range")) { // the episodes from A to B (1-based), e.g., "1001-2000" or "5000-"
+			std::string range = next_opt();
+			first = std::stoull(range);
+			if (range.find('-') == std::string::npos) last = first;
+			else if (range.back() != '-') last = std::stoull(range.substr(range.find('-') + 1));
+		} else if (match_arg("tag")) { // the episodes whose players contain this text
+			tag = next_opt();
+		} else if (match_arg("block")) {
+			block = std::max<size_t>(std::stoull(next_opt()), 1);
+		} else if (match_arg("bin")) { // the bin width of the score histogram
+			bin = std::max<size_t>(std::stoull(next_opt()), 1);
+		} else if (match_arg("steps")) { // the bin width of the length histogram
+			steps = std::max<size_t>(std::stoull(next_opt()), 1);
+		} else if (match_arg("threads")) {
+			threads = next_opt();
+		} else if (match_arg("affinity")) {
+			affinity = next_opt();
+		} else if (match_arg("numa")) {
+			numa = next_opt();
+		}
+	}
+
+	workers pool(threads, affinity, numa);
+	archive records(archive_path);
+	std::vector<summary> parts(pool.size());
+	records.scan(pool, [&](size_t id, size_t index, const std::string& line) {
+		if (index + 1 < first || index + 1 > last) return;
+		episode ep;
+		if (!(std::stringstream(line) >> ep)) return;
+		if (tag.size() && ep.open_tag().find(tag) == std::string::npos) return;
+		parts[id].add(index, ep, block, bin, steps);
+	});
+	summary all;
+	for (const summary& s : parts) all.merge(s);
+
+	std::ofstream file;
+	if (json_path.size()) file.open(json_path, std::ios::out | std::ios::trunc);
+	std::ostream& out = json_path.size() ? file : std::cout;
+	auto quote = [](const std::string& text) {
+		std::string q = "\"";
+		for (char c : text) q += (c == '"' || c == '\\') ? std::string("\\") + c : std::string(1, c);
+		return q + "\"";
+	};
+	auto tiles = [](const std::array<size_t, 32>& count) { // the largest tile -> games, and the rate of reaching it
+		std::stringstream ss;
+		size_t total = 0, reach = 0;
+		for (size_t n : count) total += n;
+		ss << "{";
+		for (size_t t = 0, k = 0; t < count.size(); t++) {
+			if (!count[t]) continue;
+			reach = 0;
+			for (size_t u = t; u < count.size(); u++) reach += count[u];
+			ss << (k++ ? "," : "") << "\"" << board::itot(t) << "\":{\"games\":" << count[t]
+			   << ",\"reach\":" << (total ? double(reach) / total : 0) << "}";
+		}
+		ss << "}";
+		return ss.str();
+	};
+	auto percentiles = [](std::vector<time_t>& t) {
+		std::stringstream ss;
+		std::sort(t.begin(), t.end());
+		auto at = [&](double p) { return t.size() ? t[std::min(t.size() - 1, size_t(p * t.size()))] : 0; };
+		double mean = 0;
+		for (time_t v : t) mean += v;
+		ss << "{\"moves\":" << t.size() << ",\"mean\":" << (t.size() ? mean / t.size() : 0) << ",\"p50\":" << at(0.5)
+		   << ",\"p90\":" << at(0.9) << ",\"p99\":" << at(0.99) << ",\"max\":" << (t.size() ? t.back() : 0) << "}";
+		return ss.str();
+	};
+
+	out << "{\"archive\":" << quote(archive_path) << ",\"episodes\":" << all.episodes;
+	out << ",\"score\":{\"mean\":" << (all.episodes ? double(all.score_sum) / all.episodes : 0) << ",\"max\":" << all.score_max << "}";
+	out << ",\"tiles\":" << tiles(all.tiles);
+	out << ",\"blocks\":[";
+	for (auto it = all.blocks.begin(); it != all.blocks.end(); it++) {
+		size_t games = 0;
+		for (size_t n : it->second) games += n;
+		out << (it != all.blocks.begin() ? "," : "") << "{\"from\":" << (it->first * block + 1) << ",\"games\":" << games
+		    << ",\"mean\":" << double(all.block_scores[it->first]) / games << ",\"tiles\":" << tiles(it->second) << "}";
+	}
+	out << "],\"scores\":[";
+	for (auto it = all.scores.begin(); it != all.scores.end(); it++) {
+		out << (it != all.scores.begin() ? "," : "") << "{\"from\":" << (it->first * bin) << ",\"games\":" << it->second << "}";
+	}
+	out << "],\"lengths\":[";
+	for (auto it = all.lengths.begin(); it != all.lengths.end(); it++) {
+		out << (it != all.lengths.begin() ? "," : "") << "{\"from\":" << (it->first * steps) << ",\"games\":" << it->second << "}";
+	}
+	out << "],\"slides\":{\"up\":" << all.slides[0] << ",\"right\":" << all.slides[1]
+	    << ",\"down\":" << all.slides[2] << ",\"left\":" << all.slides[3] << "}";
+	out << ",\"time\":{\"slider\":" << percentiles(all.times[0]) << ",\"placer\":" << percentiles(all.times[1]) << "}}" << std::endl;
+	return 0;
+}
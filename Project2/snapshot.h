@@ -0,0 +1,121 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * snapshot.h: Forked children working on a copy-on-write snapshot of the process
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/**
+ * run jobs in forked children, each of which sees the memory of the parent as it was at the fork,
+ * e.g., the weights being trained, without copying them until the parent modifies the pages
+ * a job returns a report, which is sent back through a pipe and collected by poll or wait
+ *
+ * a job should not write to the shared files, and the child exits without running any destructor,
+ * so that nothing of the parent, e.g., saving the weights, is done twice
+ */
+class snapshot {
+public:
+	snapshot(size_t limit = 1) : limit(limit) {}
+	snapshot(const snapshot&) = delete;
+	snapshot& operator =(const snapshot&) = delete;
+	~snapshot() { wait(); }
+
+public:
+	/**
+	 * fork a child running job(), unless there are already 'limit' children running
+	 * return false if the job is skipped
+	 */
+	template<typename task>
+	bool spawn(task job) {
+		if (running.size() >= limit) return false;
+		int fd[2];
+		if (pipe(fd) != 0) throw std::runtime_error("cannot create pipe");
+		std::cout.flush();
+		std::cerr.flush();
+		pid_t pid = fork();
+		if (pid < 0) {
+			close(fd[0]);
+			close(fd[1]);
+			throw std::runtime_error("cannot fork");
+		}
+		if (pid == 0) {
+			close(fd[0]);
+			std::string report = job();
+			for (size_t done = 0; done < report.size(); ) {
+				ssize_t n = write(fd[1], report.data() + done, report.size() - done);
+				if (n <= 0) break;
+				done += n;
+			}
+			_exit(0);
+		}
+		close(fd[1]);
+		fcntl(fd[0], F_SETFL, fcntl(fd[0], F_GETFL) | O_NONBLOCK);
+		running.push_back({ pid, fd[0], "" });
+		return true;
+	}
+
+	/**
+	 * collect the reports of the finished children, without blocking
+	 */
+	std::vector<std::string> poll() {
+		return collect(false);
+	}
+
+	/**
+	 * collect the reports of all the children, blocking until they finish
+	 */
+	std::vector<std::string> wait() {
+		return collect(true);
+	}
+
+	size_t size() const { return running.size(); }
+
+protected:
+	struct child {
+		pid_t pid;
+		int fd;
+		std::string report;
+	};
+
+	std::vector<std::string> collect(bool block) {
+		std::vector<std::string> reports;
+		for (auto it = running.begin(); it != running.end(); ) {
+			if (block) fcntl(it->fd, F_SETFL, fcntl(it->fd, F_GETFL) & ~O_NONBLOCK); // read until the child closes the pipe
+			drain(*it);
+			int status;
+			if (waitpid(it->pid, &status, block ? 0 : WNOHANG) != it->pid) {
+				it++;
+				continue;
+			}
+			drain(*it);
+			close(it->fd);
+			reports.push_back(it->report);
+			it = running.erase(it);
+		}
+		return reports;
+	}
+
+	/**
+	 * read what the child has written so far, so that a long report never blocks it
+	 */
+	static void drain(child& c) {
+		char buf[4096];
+		for (ssize_t n; (n = read(c.fd, buf, sizeof(buf))) > 0; ) c.report.append(buf, n);
+	}
+
+private:
+	size_t limit;
+	std::vector<child> running;
+};
@@ -0,0 +1,194 @@
+/**
+ * Framework for Threes! and its variants (C++ 11)
+ * threads.h: Sizing and placement of worker threads
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+/**
+ * worker threads of a parallel mode, sized and placed by the command line options
+ *
+ * threads:  "auto" for the CPUs this process may really use, i.e., the cgroup CPU quota and the
+ *           inherited affinity mask are respected instead of std::thread::hardware_concurrency();
+ *           or a positive number
+ * affinity: "" for no pinning; "auto" for pinning the workers to the available CPUs in turn;
+ *           or a CPU list, e.g., "0-3,8", where the i-th worker is pinned to the (i % n)-th CPU
+ * numa:     "" for any node; or a node list, e.g., "0" or "0,1", which limits the CPUs to these nodes,
+ *           the workers are bound to the whole node set unless affinity is also given
+ */
+class workers {
+public:
+	workers(const std::string& threads = "1", const std::string& affinity = "", const std::string& numa = "") : num(1), bind(false) {
+		cpus = allowed_cpus();
+		if (numa.size()) {
+			std::vector<int> nodes;
+			for (int node : parse_list(numa)) {
+				for (int cpu : read_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")) {
+					if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) nodes.push_back(cpu);
+				}
+			}
+			if (nodes.empty()) throw std::invalid_argument("no available CPU on NUMA node " + numa);
+			cpus = nodes;
+			bind = true;
+		}
+		if (affinity.size() && affinity != "auto") {
+			std::vector<int> list = parse_list(affinity);
+			std::vector<int> pick;
+			for (int cpu : list) {
+				if (std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) pick.push_back(cpu);
+			}
+			if (pick.empty()) throw std::invalid_argument("no available CPU in affinity " + affinity);
+			cpus = pick;
+		}
+		if (affinity.size()) {
+			slots = cpus;
+			bind = false;
+		}
+		if (threads == "auto") {
+			num = std::min(cpus.size(), cpu_quota());
+		} else if (threads.size()) {
+			num = std::stoul(threads);
+		}
+		num = std::max(num, size_t(1));
+	}
+
+public:
+	/**
+	 * the number of workers
+	 */
+	size_t size() const { return num; }
+
+	/**
+	 * pin the calling thread as the i-th worker
+	 */
+	void pin(size_t i) const {
+		if (slots.size()) {
+			set_affinity({ slots[i % slots.size()] });
+		} else if (bind) {
+			set_affinity(cpus);
+		}
+	}
+
+	/**
+	 * run job(i) on each worker, the calling thread serves as worker 0
+	 * return after all the workers have finished
+	 */
+	template<typename task>
+	void run(task job) const {
+		std::vector<std::thread> pool;
+		for (size_t i = 1; i < num; i++) {
+			pool.emplace_back([this, i, &job]() { pin(i); job(i); });
+		}
+		pin(0);
+		job(0);
+		for (std::thread& th : pool) th.join();
+	}
+
+public:
+	/**
+	 * the CPU limit given by the cgroup (v2 cpu.max or v1 cfs quota), rounded up
+	 * return the number of usable CPUs if there is no limit
+	 */
+	static size_t cpu_quota() {
+		size_t limit = allowed_cpus().size();
+		std::vector<std::string> v2 = { "/sys/fs/cgroup/cpu.max" };
+		std::ifstream proc("/proc/self/cgroup");
+		for (std::string line; std::getline(proc, line); ) {
+			if (line.compare(0, 3, "0::") == 0 && line.size() > 4)
+				v2.insert(v2.begin(), "/sys/fs/cgroup" + line.substr(3) + "/cpu.max");
+		}
+		for (const std::string& path : v2) {
+			std::ifstream in(path);
+			std::string quota;
+			double period = 0;
+			if (in >> quota >> period) {
+				if (quota != "max" && period > 0) limit = std::min(limit, size_t(std::ceil(std::stod(quota) / period)));
+				return std::max(limit, size_t(1));
+			}
+		}
+		for (const char* dir : { "/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct" }) {
+			std::ifstream q(std::string(dir) + "/cpu.cfs_quota_us"), p(std::string(dir) + "/cpu.cfs_period_us");
+			double quota = -1, period = 0;
+			if (q >> quota && p >> period) {
+				if (quota > 0 && period > 0) limit = std::min(limit, size_t(std::ceil(quota / period)));
+				break;
+			}
+		}
+		return std::max(limit, size_t(1));
+	}
+
+	/**
+	 * the CPUs in the affinity mask inherited by this process
+	 */
+	static std::vector<int> allowed_cpus() {
+		std::vector<int> list;
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+			for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+				if (CPU_ISSET(cpu, &set)) list.push_back(cpu);
+			}
+		}
+#endif
+		if (list.empty()) {
+			for (unsigned cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); cpu++) list.push_back(cpu);
+		}
+		return list;
+	}
+
+	/**
+	 * parse a list such as "0-3,8,10-11"
+	 */
+	static std::vector<int> parse_list(const std::string& text) {
+		std::vector<int> list;
+		std::stringstream ss(text);
+		for (std::string range; std::getline(ss, range, ','); ) {
+			if (range.empty() || !std::isdigit(range[0])) continue;
+			size_t dash = range.find('-');
+			int lo = std::stoi(range.substr(0, dash));
+			int hi = dash != std::string::npos ? std::stoi(range.substr(dash + 1)) : lo;
+			for (int i = lo; i <= hi; i++) list.push_back(i);
+		}
+		return list;
+	}
+
+protected:
+	static std::vector<int> read_list(const std::string& path) {
+		std::ifstream in(path);
+		std::string text;
+		std::getline(in, text);
+		return parse_list(text);
+	}
+
+	static void set_affinity(const std::vector<int>& list) {
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : list) CPU_SET(cpu, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+	}
+
+private:
+	size_t num;
+	bool bind;
+	std::vector<int> cpus;
+	std::vector<int> slots;
+};
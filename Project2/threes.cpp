@@ -9,22 +9,31 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <iterator>
 #include <string>
+#include <vector>
+#include <chrono>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
 #include "episode.h"
 #include "statistics.h"
+#include "threads.h"
+#include "snapshot.h"
+#include "alloc.h"
 
 int main(int argc, const char* argv[]) {
 	std::cout << "Threes! Demo: ";
 	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cout, " "));
 	std::cout << std::endl << std::endl;
 
-	size_t total = 1000, block = 0, limit = 0;
+	size_t total = 1000, block = 0, limit = 0, interleave = 1;
 	std::string slide_args, place_args;
 	std::string load_path, save_path;
+	std::string affinity, numa; // for worker threads
+	size_t evaluate = 0, every = 0; // evaluation games played by a forked child every 'every' episodes
+	std::string spare; // the CPUs for the evaluation child
 	for (int i = 1; i < argc; i++) {
 		std::string arg = argv[i];
 		auto match_arg = [&](std::string flag) -> bool {
@@ -41,6 +50,18 @@ int main(int argc, const char* argv[]) {
 			block = std::stoull(next_opt());
 		} else if (match_arg("limit")) {
 			limit = std::stoull(next_opt());
+		} else if (match_arg("interleave")) {
+			interleave = std::stoull(next_opt());
+		} else if (match_arg("evaluate")) {
+			evaluate = std::stoull(next_opt());
+		} else if (match_arg("every")) {
+			every = std::stoull(next_opt());
+		} else if (match_arg("spare")) {
+			spare = next_opt();
+		} else if (match_arg("affinity")) {
+			affinity = next_opt();
+		} else if (match_arg("numa")) {
+			numa = next_opt();
 		} else if (match_arg("slide") || match_arg("play")) {
 			slide_args = next_opt();
 		} else if (match_arg("place") || match_arg("env")) {
@@ -53,6 +74,7 @@ int main(int argc, const char* argv[]) {
 	}
 
 	statistics stats(total, block, limit);
+	if (!every) every = block ? block : total;
 
 	if (load_path.size()) {
 		std::ifstream in(load_path, std::ios::in);
@@ -61,10 +83,12 @@ int main(int argc, const char* argv[]) {
 		if (stats.is_finished()) stats.summary();
 	}
 
+	workers pool("1", affinity, numa);
+	pool.pin(0); // the games are played by the main thread
 	tuple_agent slide(slide_args);
 	random_placer place(place_args);
 
-	while (!stats.is_finished()) {
+	auto play_episode = [&](statistics& stats, agent& place) {
 //		std::cerr << "======== Game " << stats.step() << " ========" << std::endl;
 		slide.open_episode("~:" + place.name());
 		place.open_episode(slide.name() + ":~");
@@ -73,18 +97,129 @@ int main(int argc, const char* argv[]) {
 		episode& game = stats.back();
 		while (true) {
 			agent& who = game.take_turns(slide, place);
-			action move = who.take_action(game.state());
+			action move;
+			{
+				allocation::phase scope(&who == &slide ? "slide" : "place");
+				move = who.take_action(game.state());
+			}
 //			std::cerr << game.state() << "#" << game.step() << " " << who.name() << ": " << move << std::endl;
+			allocation::phase scope("record");
 			if (game.apply_action(move) != true) break;
 			if (who.check_for_win(game.state())) break;
 		}
 		agent& win = game.last_turns(slide, place);
 		stats.close_episode(win.name());
 
+		allocation::phase scope("learn");
 		slide.close_episode(win.name());
 		place.close_episode(win.name());
+	};
+
+	// evaluate the current weights without stopping the training, in a child forked every 'every' episodes
+	// the child shares the weights copy-on-write, plays with alpha=0 on a lane of its own, and sends back its statistics
+	snapshot children;
+	size_t forked = stats.step();
+	auto checkpoint = [&]() {
+		for (const std::string& report : children.poll()) std::cout << report << std::flush;
+		if (!evaluate || stats.step() - forked < every) return;
+		forked = stats.step();
+		bool spawned = children.spawn([&]() -> std::string {
+			if (spare.size()) workers("1", spare).pin(0);
+			std::stringstream report;
+			std::streambuf* out = std::cout.rdbuf(report.rdbuf());
+			slide.switch_lane(interleave);
+			slide.notify("alpha=0");
+			random_placer env(place_args);
+			statistics eval(evaluate);
+			while (!eval.is_finished()) play_episode(eval, env);
+			std::cout.rdbuf(out);
+			return "evaluation at " + std::to_string(forked) + ":\n" + report.str();
+		});
+		if (!spawned) std::cerr << "evaluation at " << forked << " skipped, the last one is still running" << std::endl;
+	};
+
+	if (interleave <= 1) { // play one game at a time
+		while (!stats.is_finished()) {
+			play_episode(stats, place);
+			checkpoint();
+		}
+	} else { // advance a group of games in lockstep, the slider decides for all of them at once
+		std::vector<episode> games(interleave);
+		std::vector<bool> ongoing(interleave, false);
+		std::vector<double> owed(interleave, 0); // the milliseconds of the batched moves not yet charged to each game
+		size_t started = stats.step();
+		while (!stats.is_finished()) {
+			std::vector<board> states;
+			std::vector<size_t> lanes;
+			for (size_t i = 0; i < interleave; i++) {
+				if (!ongoing[i]) {
+					if (started >= stats.total_episodes()) continue;
+					started++;
+					slide.switch_lane(i);
+					slide.open_episode("~:" + place.name());
+					place.open_episode(slide.name() + ":~");
+					games[i] = {};
+					games[i].open_episode(slide.name() + ":" + place.name());
+					ongoing[i] = true;
+				}
+
+				episode& game = games[i];
+				bool over = false;
+				while (&game.take_turns(slide, place) == &place) { // the placer moves until the slider should move
+					allocation::phase scope("place");
+					action move = place.take_action(game.state());
+					if (game.apply_action(move) != true || place.check_for_win(game.state())) {
+						over = true;
+						break;
+					}
+				}
+				if (!over) {
+					states.push_back(game.state());
+					lanes.push_back(i);
+					continue;
+				}
+
+				agent& win = game.last_turns(slide, place);
+				stats.append_episode(std::move(game), win.name());
+				allocation::phase scope("learn");
+				slide.switch_lane(i);
+				slide.close_episode(win.name());
+				place.close_episode(win.name());
+				ongoing[i] = false;
+				checkpoint();
+			}
+
+			// the time of the batch is shared by its games, and the fractions of a millisecond are carried to their next moves
+			std::vector<action> moves;
+			auto start = std::chrono::steady_clock::now();
+			{
+				allocation::phase scope("slide");
+				moves = slide.take_actions(states, lanes);
+			}
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			for (size_t n = 0; n < moves.size(); n++) {
+				size_t i = lanes[n];
+				episode& game = games[i];
+				owed[i] += elapsed.count() / moves.size();
+				time_t spent = time_t(owed[i]);
+				owed[i] -= spent;
+				if (game.apply_action(moves[n], spent) == true && slide.check_for_win(game.state()) != true) continue;
+
+				agent& win = game.last_turns(slide, place);
+				stats.append_episode(std::move(game), win.name());
+				allocation::phase scope("learn");
+				slide.switch_lane(i);
+				slide.close_episode(win.name());
+				place.close_episode(win.name());
+				ongoing[i] = false;
+				checkpoint();
+			}
+		}
 	}
 
+	for (const std::string& report : children.wait()) std::cout << report << std::flush;
+	allocation::report(std::cout, true);
+
 	if (save_path.size()) {
 		std::ofstream out(save_path, std::ios::out | std::ios::trunc);
 		out << stats;
@@ -17,8 +17,16 @@
 #include <fstream>
 #include <unistd.h>
 #include <ctime>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <deque>
 #include "board.h"
 #include "action.h"
+#include "bitboard.h"
+#include "endgame.h"
+#include "arena.h"
+#include "threads.h"
 
 class agent {
 public:
@@ -62,6 +70,10 @@ public:
 		if (meta.find("seed") != meta.end()){
 			engine.seed(int(meta["seed"]));
 		}
+		if (meta.find("stream") != meta.end()){ // an independent stream for each player, mixed with the seed so that close streams are not correlated
+			std::seed_seq mix{ unsigned(engine()), unsigned(int(meta["stream"])) };
+			engine.seed(mix);
+		}
 	}
 	virtual ~random_agent(){}
 
@@ -75,6 +87,8 @@ protected:
  */
 class player : public random_agent {
 public:
+	struct node;
+
 	player(const std::string& args = "") : random_agent("name=random role=unknown " + args),
 		space(board::size_x * board::size_y), opp_space(board::size_x * board::size_y), who(board::empty){
 
@@ -100,14 +114,60 @@ public:
 				opp_space[i] = action::place(i, board::black);
 			}
 		}
+		if (meta.find("playouts") != meta.end()){ // playouts per leaf, run on bitboards
+			playout_count = int(meta["playouts"]);
+		}
+		if (meta.find("lgrf") != meta.end()){ // last-good-reply-with-forgetting playouts, which run on bitboards
+			use_replies = int(meta["lgrf"]) != 0;
+			if (use_replies && playout_count == 0) playout_count = 1;
+		}
+		if (meta.find("endgame") != meta.end()){ // solve exactly once every region has at most this many empty points
+			endgame_limit = int(meta["endgame"]);
+		}
+		if (meta.find("timeout") != meta.end()){ // search time per move in milliseconds
+			search_time = std::chrono::milliseconds(int(meta["timeout"]));
+		}
+		if (meta.find("egtb") != meta.end()){ // look up the small regions in a table made by egtb
+			table = std::make_shared<egtable>(property("egtb"));
+		}
+		if (meta.find("reuse") != meta.end()){ // keep the subtree of the moves played for the next search
+			reuse_tree = int(meta["reuse"]) != 0;
+		}
+	}
+	virtual ~player(){
+		drop_tree();
+	}
+
+	virtual void open_episode(const std::string& flag = "") {
+		solver = endgame(table.get());
+		reply_table.clear();
+		drop_tree();
 	}
 
 	virtual action take_action(const board& state) {
-		node* root = new_node(state);
+		last_count = 0;
+		if(relayout.joinable()){
+			relayout.join();
+		}
+		auto start_time = std::chrono::steady_clock::now(); // get current time, std::clock() would count all threads
+
+		if(endgame_limit > 0){ // the solver may take half of the time, and the search takes the rest if it gives up
+			int move = solver.solve(state, endgame_limit, start_time + search_time / 2);
+			if(move >= 0){
+				drop_tree();
+				return action::place(move, who);
+			}
+		}
+
+		node* root = reuse_tree ? find_node(state) : nullptr;
+		if(root == nullptr){
+			tree.clear();
+			root = new_node(state);
+		}
+		float reused = root->visit_count;
+		total_count = reused;
 		simulation_count = stoi(property("N"));
 		weight = stof(property("c"));
-		
-		std::clock_t start_time = std::clock(); // get current time
 
 		// while(total_count<simulation_count){
 		// 	our_turn = true;
@@ -119,14 +179,16 @@ public:
 			our_turn = true;
 			update_nodes.push_back(root);
 			insert(root, state);
-			if((std::clock() - start_time)/ (double) CLOCKS_PER_SEC > 1) {
+			if(std::chrono::steady_clock::now() - start_time > search_time) {
 				break;
 			}
 		}
 
+		last_count = total_count - reused;
  		total_count = 0;
 
 		if(root->childs.size() == 0){
+			drop_tree();
 			return action();
 		}
 
@@ -163,25 +225,117 @@ public:
 			board after = state;
 			if (move.apply(after) == board::legal){
 				if(after == root->childs[index]->state){
-					delete_node(root);
+					keep_tree(root->childs[index]);
 					return move;
 				}
 			}
 		}
-		delete_node(root);
+		drop_tree();
 		return action();
 	}
 
+	/**
+	 * the node of the state in the kept tree, i.e., one of the replies to the move played
+	 * return nullptr if the state is not there, e.g., after an undo
+	 */
+	struct node* find_node(const board& state){
+		if(kept == nullptr){
+			return nullptr;
+		}
+		for(node* child : kept->childs){
+			if(child->state == state){
+				return child;
+			}
+		}
+		return nullptr;
+	}
+
+	/**
+	 * keep the subtree of the move played, which is relocated into a fresh arena in breadth-first order
+	 * by another thread while the opponent thinks, and the rest of the tree is freed along with the old arena
+	 */
+	void keep_tree(struct node* chosen){
+		if(!reuse_tree){
+			drop_tree();
+			return;
+		}
+		kept = chosen;
+		relayout = std::thread([this]() {
+			if (pool) pool->pin(slot); // next to the searcher, on the same CPUs and NUMA node as its tree
+			arena fresh;
+			kept = relocate(kept, fresh);
+			tree.swap(fresh);
+		});
+	}
+
+	/**
+	 * run the relayout as the worker (id) of the pool, which should be the worker running this player
+	 */
+	void pin(const workers& pool, size_t id){
+		this->pool = std::make_shared<workers>(pool);
+		slot = id;
+	}
+
+	void drop_tree(){
+		if(relayout.joinable()){
+			relayout.join();
+		}
+		kept = nullptr;
+		tree.clear();
+	}
+
+	/**
+	 * copy the subtree of root into another arena level by level, where the children of each node are made together,
+	 * so that the nodes near the root, which selection visits most, are packed at the front
+	 */
+	static struct node* relocate(struct node* root, arena& to){
+		struct node* copy = to.make<node>();
+		*copy = *root;
+		std::deque<std::pair<node*, node*>> queue = { { root, copy } };
+		while(queue.size()){
+			node* from = queue.front().first;
+			node* into = queue.front().second;
+			queue.pop_front();
+			if(from->childs.empty()){
+				continue;
+			}
+			into->childs = make_children(to, from->childs.size());
+			for(size_t i = 0; i < from->childs.size(); i++){
+				*into->childs[i] = *from->childs[i];
+				queue.emplace_back(from->childs[i], into->childs[i]);
+			}
+		}
+		return copy;
+	}
+
+	/**
+	 * the number of playouts run by the last search
+	 */
+	float searched() const { return last_count; }
+
+	/**
+	 * the children of a node, i.e., a row of pointers made in the arena
+	 */
+	struct children{
+		node** first;
+		size_t count;
+		node** begin() const { return first; }
+		node** end() const { return first + count; }
+		node*& operator [](size_t i) const { return first[i]; }
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+	};
+
 	struct node{
  		board state;
  		float visit_count;
  		float win_count;
  		float uct_value;
- 		std::vector<node*> childs;
+ 		children childs;
  	};
 
 	struct node* new_node(board state){
- 		struct node* current_node = new struct node;
+ 		struct node* current_node = tree.make<node>();
  		current_node->visit_count = 0;
  		current_node->win_count = 0;
  		current_node->uct_value = 10000;
@@ -189,8 +343,27 @@ public:
  		return current_node;
  	}
 
-	bool simulation(struct node * current_node){
+	/**
+	 * make n children in a row, pointed to in order
+	 */
+	static children make_children(arena& where, size_t n){
+		children list = { where.make<node*>(n), n };
+		node* nodes = where.make<node>(n);
+		for(size_t i = 0; i < n; i++){
+			list[i] = nodes + i;
+		}
+		return list;
+	}
+
+	float simulation(struct node * current_node){
  		board after = current_node->state;
+
+		if(playout_count > 0){
+			size_t wins = playouts::run(bitboard(after), playout_count, who, engine, use_replies ? &reply_table : nullptr);
+			total_count += playout_count;
+			return wins;
+		}
+
  		bool end = false;
  		bool win = true;
  		int count = 0 ;
@@ -243,36 +416,30 @@ public:
 
 	void insert(struct node* root, board state){
  		// collect child
- 		size_t number_of_legal_move = 0;
-
- 		if(our_turn == true){
- 			for (const action::place& move : space) {
+ 		if(root->childs.empty()){
+			const std::vector<action::place>& moves = our_turn ? space : opp_space;
+			board afters[board::size_x * board::size_y];
+			size_t n = 0;
+ 			for (const action::place& move : moves) {
  				board after = state;
-
  				if (move.apply(after) == board::legal){
- 					if(root->childs.size() <= number_of_legal_move++){
- 						struct node * current_node = new_node(after);		
- 						root->childs.push_back(current_node);
- 					}
- 				}
- 			}
- 		}
- 		else{
- 			for (const action::place& move : opp_space) {
- 				board after = state;
- 				if (move.apply(after) == board::legal){
- 					if(root->childs.size() <= number_of_legal_move++){
- 						struct node * current_node = new_node(after);		
- 						root->childs.push_back(current_node);
- 					}
+					afters[n++] = after;
  				}
  			}
+			if(n > 0){
+				root->childs = make_children(tree, n);
+				for(size_t i = 0; i < n; i++){
+					root->childs[i]->uct_value = 10000;
+					root->childs[i]->state = afters[i];
+				}
+			}
  		}
+ 		size_t number_of_legal_move = root->childs.size();
 
  		// do simulation
  		if(root->visit_count == 0) {
- 			bool win = simulation(root);
- 			update(win);
+ 			float wins = simulation(root);
+ 			update(wins, playout_count ? playout_count : 1);
  		}
  		else{
  			int index = -1;
@@ -292,8 +459,8 @@ public:
 			}
 
  			if(number_of_legal_move == 0){
- 				bool win = simulation(root);
- 				update(win);
+ 				float wins = simulation(root);
+ 				update(wins, playout_count ? playout_count : 1);
  				return;
  			} 
 
@@ -321,16 +488,10 @@ public:
  		}
  	}
 
-	void update(bool win){
- 		float value = 0;
-
- 		if(win){
-			value = 1;
-		}
-		
+	void update(float wins, float n = 1){
  		for(size_t i = 0 ; i < update_nodes.size() ; i++){
- 			update_nodes[i]->visit_count++;
- 			update_nodes[i]->win_count += value;	
+ 			update_nodes[i]->visit_count += n;
+ 			update_nodes[i]->win_count += wins;	
  			update_nodes[i]->uct_value = (update_nodes[i]->win_count / update_nodes[i]->visit_count) + weight * log(total_count) / update_nodes[i]->visit_count;		
  		}
 
@@ -338,14 +499,9 @@ public:
  		update_nodes.clear();
  	}
 
-	void delete_node(struct node * root){
- 		for(size_t i = 0 ; i < root->childs.size(); i++)
- 			delete_node(root->childs[i]);
- 		delete(root);
- 	}
-
 	bool our_turn;
 	float total_count = 0.0;
+	float last_count = 0.0;
 	std::vector<node*> update_nodes;
 
 private:
@@ -357,5 +513,18 @@ private:
 	float visit_count;
 	float win_count;
 	int simulation_count;
+	size_t playout_count = 0;
+	bool use_replies = false;
+	replies reply_table;
+	size_t endgame_limit = 0;
+	std::chrono::milliseconds search_time = std::chrono::milliseconds(1000);
+	endgame solver;
+	std::shared_ptr<egtable> table;
 	float weight;
+	arena tree; // the nodes of the search tree
+	bool reuse_tree = false;
+	struct node* kept = nullptr; // the node of the move played, if the tree is kept
+	std::thread relayout;
+	std::shared_ptr<workers> pool; // the workers to pin the relayout to, if any
+	size_t slot = 0;
 };
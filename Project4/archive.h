@@ -0,0 +1,93 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * archive.h: Memory-mapped scanning of saved episodes
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include "threads.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * a file saved by --save, i.e., one episode per line, mapped into memory as it is
+ */
+class archive {
+public:
+	archive(const std::string& path) : base(nullptr), length(0) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) != 0) {
+			if (fd >= 0) ::close(fd);
+			throw std::runtime_error("cannot open archive " + path);
+		}
+		length = st.st_size;
+		if (length) {
+			void* map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (map == MAP_FAILED) {
+				::close(fd);
+				throw std::runtime_error("cannot map archive " + path);
+			}
+			madvise(map, length, MADV_SEQUENTIAL);
+			base = static_cast<const char*>(map);
+		}
+		::close(fd);
+	}
+	archive(const archive&) = delete;
+	archive& operator =(const archive&) = delete;
+	~archive() { if (base) munmap(const_cast<char*>(base), length); }
+
+public:
+	/**
+	 * run job(id, index, line) on each nonempty line, where index is the 0-based index of the line among the nonempty ones
+	 * the file is split into one part per worker at line boundaries, and each part is counted first,
+	 * so that the indexes are known before any line is parsed
+	 */
+	template<typename task>
+	void scan(const workers& pool, task job) const {
+		size_t num = pool.size();
+		std::vector<size_t> cut(num + 1, length);
+		cut[0] = 0;
+		for (size_t i = 1; i < num; i++) {
+			size_t at = std::max(length * i / num, cut[i - 1]);
+			const char* nl = at < length ? static_cast<const char*>(std::memchr(base + at, '\n', length - at)) : nullptr;
+			cut[i] = nl ? nl - base + 1 : length;
+		}
+		std::vector<size_t> first(num + 1, 0);
+		pool.run([&](size_t id) {
+			size_t lines = 0;
+			for_each_line(cut[id], cut[id + 1], [&](const char*, size_t) { lines++; });
+			first[id + 1] = lines;
+		});
+		for (size_t i = 0; i < num; i++) first[i + 1] += first[i];
+		pool.run([&](size_t id) {
+			size_t index = first[id];
+			for_each_line(cut[id], cut[id + 1], [&](const char* line, size_t len) { job(id, index++, std::string(line, len)); });
+		});
+	}
+
+protected:
+	template<typename task>
+	void for_each_line(size_t begin, size_t end, task job) const {
+		while (begin < end) {
+			const char* nl = static_cast<const char*>(std::memchr(base + begin, '\n', end - begin));
+			size_t stop = nl ? nl - base : end;
+			if (stop > begin && !(stop == begin + 1 && base[begin] == '\r')) job(base + begin, stop - begin);
+			begin = stop + 1;
+		}
+	}
+
+private:
+	const char* base;
+	size_t length;
+};
@@ -0,0 +1,76 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * arena.h: Bump allocation of objects which are freed all at once
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <new>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+
+/**
+ * objects are placed one after another in large chunks, in the order they are made,
+ * so that the objects made together, e.g., the children of a node, are contiguous in memory
+ * nothing is freed individually; clear() drops everything by releasing the chunks, keeping the first one for reuse
+ */
+class arena {
+public:
+	arena(size_t chunk = 1 << 20) : chunk(chunk), used(0) {}
+	arena(const arena&) = delete;
+	arena& operator =(const arena&) = delete;
+
+public:
+	/**
+	 * make n value-initialized objects in a row
+	 */
+	template<typename type>
+	type* make(size_t n = 1) {
+		static_assert(std::is_trivially_destructible<type>::value, "objects of an arena are never destroyed");
+		size_t size = sizeof(type) * n, align = alignof(type);
+		size_t at = (used + align - 1) / align * align;
+		if (blocks.empty() || at + size > blocks.back().size) {
+			blocks.push_back({ std::unique_ptr<char[]>(new char[std::max(chunk, size)]), std::max(chunk, size) });
+			at = 0;
+		}
+		used = at + size;
+		type* obj = reinterpret_cast<type*>(blocks.back().data.get() + at);
+		for (size_t i = 0; i < n; i++) new (obj + i) type();
+		return obj;
+	}
+
+	void clear() {
+		if (blocks.size() > 1) blocks.erase(blocks.begin() + 1, blocks.end());
+		if (blocks.size() && blocks[0].size != chunk) blocks.clear();
+		used = 0;
+	}
+
+	void swap(arena& a) {
+		std::swap(chunk, a.chunk);
+		std::swap(used, a.used);
+		blocks.swap(a.blocks);
+	}
+
+	/**
+	 * the bytes held by the chunks
+	 */
+	size_t capacity() const {
+		size_t total = 0;
+		for (const block& b : blocks) total += b.size;
+		return total;
+	}
+
+private:
+	struct block {
+		std::unique_ptr<char[]> data;
+		size_t size;
+	};
+	size_t chunk;
+	size_t used;
+	std::vector<block> blocks;
+};
@@ -0,0 +1,216 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * bitboard.h: Bit-parallel board and playouts for NoGo
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include "board.h"
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+/**
+ * bit-parallel board, the bit (i) stands for the point (i) of board, i.e., [x][y] is bit (x * size_y + y)
+ *
+ * the legality of all points is tested at once:
+ * a point is legal for who iff it is empty, it does not take the last liberty of an opponent block,
+ * and it has an empty neighbor or a neighboring own block with another liberty
+ */
+class bitboard {
+public:
+	typedef unsigned __int128 bits;
+	static_assert(board::size_x * board::size_y <= 128, "board is too large for bitboard");
+
+public:
+	bitboard() : stone(), turn(board::black) {}
+	bitboard(bits black, bits white, unsigned who) : stone{ black, white }, turn(who) {}
+	bitboard(const board& b) : stone(), turn(b.info().who_take_turns) {
+		const board::grid& g = b;
+		for (unsigned x = 0; x < board::size_x; x++) {
+			for (unsigned y = 0; y < board::size_y; y++) {
+				bits p = bit(x * board::size_y + y);
+				if (g[x][y] == board::black) stone[0] |= p;
+				if (g[x][y] == board::white) stone[1] |= p;
+			}
+		}
+	}
+
+public:
+	bits black() const { return stone[0]; }
+	bits white() const { return stone[1]; }
+	bits empty() const { return playable() & ~stone[0] & ~stone[1]; }
+	unsigned who_take_turns() const { return turn; }
+
+	/**
+	 * the legal points for who
+	 */
+	bits legal(unsigned who) const {
+		return legal(stone[who - 1], stone[2 - who], empty());
+	}
+	bits legal() const { return legal(turn); }
+
+	/**
+	 * place a stone of who at a point which is known to be legal
+	 */
+	void place(unsigned i, unsigned who) {
+		stone[who - 1] |= bit(i);
+		turn = 3u - who;
+	}
+	void place(unsigned i) { place(i, turn); }
+
+public:
+	static bits bit(unsigned i) { return bits(1) << i; }
+	static unsigned count(bits b) { return __builtin_popcountll(uint64_t(b)) + __builtin_popcountll(uint64_t(b >> 64)); }
+
+	/**
+	 * the index of the n-th (0-based) set bit
+	 */
+	static unsigned select(bits b, unsigned n) {
+		uint64_t lo = uint64_t(b), hi = uint64_t(b >> 64);
+		unsigned base = 0, num = __builtin_popcountll(lo);
+		if (n >= num) n -= num, lo = hi, base = 64;
+#ifdef __BMI2__
+		return base + __builtin_ctzll(_pdep_u64(uint64_t(1) << n, lo));
+#else
+		while (n--) lo &= lo - 1;
+		return base + __builtin_ctzll(lo);
+#endif
+	}
+
+	/**
+	 * the points next to any point of b
+	 */
+	static bits neighbors(bits b) {
+		static const bits low = edge(0), high = edge(board::size_y - 1), all = full();
+		return ((b << board::size_y) | (b >> board::size_y) | ((b << 1) & ~low) | ((b >> 1) & ~high)) & all;
+	}
+
+	/**
+	 * the legal points for the side owning own, where only the points in space are empty
+	 */
+	static bits legal(bits own, bits opp, bits space) {
+		bits own_last, opp_last;
+		bits own_atari = last_liberty(own, space, own_last);
+		last_liberty(opp, space, opp_last);
+		return space & ~opp_last & (neighbors(space) | neighbors(own & ~own_atari));
+	}
+
+	/**
+	 * the points of within which are connected to seed
+	 */
+	static bits connect(bits seed, bits within) {
+		for (bits grow; (grow = (seed | neighbors(seed)) & within) != seed; seed = grow);
+		return seed;
+	}
+
+	/**
+	 * the blocks of stones which have exactly one liberty, and their liberties are stored in last
+	 */
+	static bits last_liberty(bits stones, bits space, bits& last) {
+		bits atari = 0;
+		last = 0;
+		for (bits rest = stones; rest; ) {
+			bits block = connect(rest & -rest, stones);
+			rest &= ~block;
+			bits liberty = neighbors(block) & space;
+			if (liberty && !(liberty & (liberty - 1))) {
+				atari |= block;
+				last |= liberty;
+			}
+		}
+		return atari;
+	}
+
+protected:
+	static bits full() { return (bits(1) << (board::size_x * board::size_y)) - 1; }
+	static bits edge(unsigned y) {
+		bits e = 0;
+		for (unsigned x = 0; x < board::size_x; x++) e |= bit(x * board::size_y + y);
+		return e;
+	}
+	static bits playable() {
+		static const bits mask = []() {
+			bits m = 0;
+			board b;
+			const board::grid& g = b;
+			for (unsigned x = 0; x < board::size_x; x++)
+				for (unsigned y = 0; y < board::size_y; y++)
+					if (g[x][y] != board::hollow) m |= bit(x * board::size_y + y);
+			return m;
+		}();
+		return mask;
+	}
+
+private:
+	bits stone[2];
+	unsigned turn;
+};
+
+/**
+ * last-good-reply-with-forgetting tables, i.e., the last reply of each color to each move which won a playout
+ * the replies of the winner of a playout are stored, and the stored replies played by the loser are forgotten
+ * a table belongs to one searcher (one per thread), so it needs no locking
+ */
+class replies {
+public:
+	enum { points = board::size_x * board::size_y };
+
+	replies() { clear(); }
+	void clear() { reply.fill(-1); }
+
+	/**
+	 * the stored reply of who to the move (last), or -1 if there is none
+	 */
+	int get(unsigned who, int last) const { return last >= 0 ? reply[(who - 1) * points + last] : -1; }
+
+	/**
+	 * learn from a playout of moves, where moves[0] is played by first and winner has won
+	 */
+	void learn(const uint8_t* moves, size_t num, unsigned first, unsigned winner) {
+		for (size_t k = 1; k < num; k++) {
+			unsigned who = (k % 2) ? 3u - first : first;
+			int16_t& r = reply[(who - 1) * points + moves[k - 1]];
+			if (who == winner) r = moves[k];
+			else if (r == moves[k]) r = -1;
+		}
+	}
+
+private:
+	std::array<int16_t, 2 * points> reply;
+};
+
+/**
+ * random playouts on a bitboard, where the legal points of each move are found at once by bitboard::legal
+ */
+class playouts {
+public:
+	/**
+	 * play n random playouts from the state one after another
+	 * return how many of them are won by who, i.e., the opponent of who has no legal move at the end
+	 * with a reply table, a stored reply to the previous move is played whenever it is legal, and the table learns from each playout
+	 */
+	template<typename engine>
+	static size_t run(const bitboard& start, size_t n, unsigned who, engine& rng, replies* table = nullptr) {
+		size_t wins = 0;
+		std::array<uint8_t, replies::points> played;
+		for (size_t k = 0; k < n; k++) {
+			bitboard b = start;
+			size_t length = 0;
+			for (bitboard::bits moves; (moves = b.legal()) != 0; ) {
+				int reply = table && length ? table->get(b.who_take_turns(), played[length - 1]) : -1;
+				unsigned i = reply >= 0 && (moves & bitboard::bit(reply)) ? reply : bitboard::select(moves, rng() % bitboard::count(moves));
+				if (table) played[length++] = i;
+				b.place(i);
+			}
+			wins += b.who_take_turns() != who; // the side to move loses
+			if (table) table->learn(played.data(), length, start.who_take_turns(), 3u - b.who_take_turns());
+		}
+		return wins;
+	}
+};
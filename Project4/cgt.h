@@ -0,0 +1,139 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * cgt.h: Canonical forms of short partizan games
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * a store of games in canonical form, each game is an index, and game 0 is the zero game { | }
+ * Left and Right are black and white in NoGo, and the player who cannot move loses
+ */
+class cgt {
+public:
+	cgt() { form({}, {}); }
+
+	/**
+	 * a game given by its options, which are indexes of other games
+	 */
+	struct game {
+		std::vector<int> left;
+		std::vector<int> right;
+	};
+
+	const game& at(int g) const { return games[g]; }
+
+	/**
+	 * G <= H iff there is no G^L >= H and no H^R <= G
+	 */
+	bool le(int g, int h) {
+		uint64_t key = (uint64_t(g) << 32) | uint64_t(h);
+		auto it = order.find(key);
+		if (it != order.end()) return it->second;
+		bool res = true;
+		for (size_t i = 0; res && i < games[g].left.size(); i++) res = !le(h, games[g].left[i]);
+		for (size_t i = 0; res && i < games[h].right.size(); i++) res = !le(games[h].right[i], g);
+		return order[key] = res;
+	}
+
+	/**
+	 * the canonical form of { left | right }, whose options are canonical
+	 * dominated options are removed and reversible options are bypassed
+	 */
+	int canonical(std::vector<int> left, std::vector<int> right) {
+		for (bool changed = true; changed; ) {
+			changed = false;
+			dominate(left, true);
+			dominate(right, false);
+			int g = form(left, right);
+			for (size_t i = 0; i < left.size() && !changed; i++) {
+				for (int ar : std::vector<int>(games[left[i]].right)) {
+					if (!le(ar, g)) continue;
+					std::vector<int> bypass = games[ar].left;
+					left.erase(left.begin() + i);
+					left.insert(left.end(), bypass.begin(), bypass.end());
+					changed = true;
+					break;
+				}
+			}
+			for (size_t i = 0; i < right.size() && !changed; i++) {
+				for (int bl : std::vector<int>(games[right[i]].left)) {
+					if (!le(g, bl)) continue;
+					std::vector<int> bypass = games[bl].right;
+					right.erase(right.begin() + i);
+					right.insert(right.end(), bypass.begin(), bypass.end());
+					changed = true;
+					break;
+				}
+			}
+		}
+		return form(left, right);
+	}
+
+	/**
+	 * the canonical form of G + H, i.e., { G^L + H, G + H^L | G^R + H, G + H^R }
+	 */
+	int add(int g, int h) {
+		if (g == 0) return h;
+		if (h == 0) return g;
+		if (g > h) std::swap(g, h);
+		auto key = std::make_pair(g, h);
+		auto it = sums.find(key);
+		if (it != sums.end()) return it->second;
+		std::vector<int> left, right;
+		for (int gl : std::vector<int>(games[g].left))  left.push_back(add(gl, h));
+		for (int hl : std::vector<int>(games[h].left))  left.push_back(add(g, hl));
+		for (int gr : std::vector<int>(games[g].right)) right.push_back(add(gr, h));
+		for (int hr : std::vector<int>(games[h].right)) right.push_back(add(g, hr));
+		return sums[key] = canonical(left, right);
+	}
+
+	size_t size() const { return games.size(); }
+
+protected:
+	/**
+	 * keep only the best options, i.e., the maximal ones for left and the minimal ones for right
+	 */
+	void dominate(std::vector<int>& options, bool left) {
+		std::sort(options.begin(), options.end());
+		options.erase(std::unique(options.begin(), options.end()), options.end());
+		for (size_t i = 0; i < options.size(); ) {
+			bool worse = false;
+			for (size_t j = 0; j < options.size() && !worse; j++) {
+				if (i != j) worse = left ? le(options[i], options[j]) : le(options[j], options[i]);
+			}
+			if (worse) options.erase(options.begin() + i);
+			else       i++;
+		}
+	}
+
+	/**
+	 * the index of the game form { left | right }
+	 */
+	int form(std::vector<int> left, std::vector<int> right) {
+		std::sort(left.begin(), left.end());
+		left.erase(std::unique(left.begin(), left.end()), left.end());
+		std::sort(right.begin(), right.end());
+		right.erase(std::unique(right.begin(), right.end()), right.end());
+		auto key = std::make_pair(left, right);
+		auto it = forms.find(key);
+		if (it != forms.end()) return it->second;
+		games.push_back({ left, right });
+		return forms[key] = int(games.size() - 1);
+	}
+
+protected:
+	std::vector<game> games;
+	std::map<std::pair<std::vector<int>, std::vector<int>>, int> forms;
+	std::unordered_map<uint64_t, bool> order;
+	std::map<std::pair<int, int>, int> sums;
+};
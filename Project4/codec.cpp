@@ -0,0 +1,129 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * codec.cpp: Throughput and consistency check of the position codec
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <sstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <functional>
+#include "board.h"
+#include "bitboard.h"
+#include "codec.h"
+
+int main(int argc, const char* argv[]) {
+	std::cerr << "HollowNoGo-Codec: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cerr, " "));
+	std::cerr << std::endl << std::endl;
+
+	size_t games = 1000, repeat = 100;
+	unsigned seed = 0;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto match_arg = [&](std::string flag) -> bool {
+			auto it = arg.find_first_not_of('-');
+			return arg.find(flag, it) == it;
+		};
+		auto next_opt = [&]() -> std::string {
+			auto it = arg.find('=') + 1;
+			return it ? arg.substr(it) : argv[++i];
+		};
+		if (match_arg("games")) {
+			games = std::max<size_t>(std::stoull(next_opt()), 1);
+		} else if (match_arg("repeat")) { // the passes over the positions for the timing
+			repeat = std::max<size_t>(std::stoull(next_opt()), 1);
+		} else if (match_arg("seed")) {
+			seed = std::stoul(next_opt());
+		}
+	}
+
+	// every position of random games, played by board::place to be independent of the bitboard
+	std::default_random_engine engine(seed);
+	std::vector<board> positions;
+	for (size_t g = 0; g < games; g++) {
+		board b;
+		positions.push_back(b);
+		while (true) {
+			bitboard::bits legal = bitboard(b).legal();
+			if (!legal) break;
+			b.place(board::point(bitboard::select(legal, engine() % bitboard::count(legal))));
+			positions.push_back(b);
+		}
+	}
+
+	// the symmetry (s) applied to a board, by the same convention as position::transform
+	auto transform = [](const board& b, unsigned s) {
+		board t;
+		const board::grid& g = b;
+		board::grid& h = t;
+		for (unsigned x = 0; x < board::size_x; x++) {
+			for (unsigned y = 0; y < board::size_y; y++) {
+				unsigned tx = (s & 1) ? board::size_x - 1 - x : x, ty = (s & 2) ? board::size_y - 1 - y : y;
+				if (s & 4) std::swap(tx, ty);
+				h[tx][ty] = g[x][y];
+			}
+		}
+		t.info(b.info());
+		return t;
+	};
+
+	// the round trips through the code and through its text, and the canonical code shared by all symmetric positions
+	size_t mismatches = 0;
+	auto mismatch = [&](size_t i, const std::string& what) {
+		if (mismatches++ < 10) std::cerr << "position " << i << ": " << what << std::endl << positions[i];
+	};
+	for (size_t i = 0; i < positions.size(); i++) {
+		const board& b = positions[i];
+		position p(b);
+		if (board(p) != b || board(p).info().who_take_turns != b.info().who_take_turns) mismatch(i, "board round trip");
+		bitboard bb = p;
+		if (bb.black() != bitboard(b).black() || bb.white() != bitboard(b).white()) mismatch(i, "bitboard round trip");
+		std::stringstream text;
+		position q;
+		text << p;
+		if (!(text >> q) || q != p) mismatch(i, "text round trip");
+		position least = p.canonical();
+		for (unsigned s = 0; s < 8; s++) {
+			board t = transform(b, s);
+			if (p.transform(s) != position(t)) mismatch(i, "symmetry " + std::to_string(s));
+			if (position(t).canonical() != least) mismatch(i, "canonical of symmetry " + std::to_string(s));
+		}
+	}
+
+	// the time per position of each operation
+	std::vector<bitboard> boards(positions.begin(), positions.end());
+	std::vector<position> codes(positions.size());
+	volatile size_t sink = 0; // keep the results alive
+	auto time = [&](const char* name, std::function<void()> pass) {
+		auto start = std::chrono::steady_clock::now();
+		for (size_t r = 0; r < repeat; r++) pass();
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << name << " = " << (elapsed.count() / repeat / positions.size()) << "ns" << std::endl;
+	};
+	time("encode", [&]() {
+		for (size_t i = 0; i < boards.size(); i++) codes[i] = position(boards[i].black(), boards[i].white(), boards[i].who_take_turns());
+	});
+	time("decode", [&]() {
+		for (const position& p : codes) sink += bitboard::count(p.black() | p.white());
+	});
+	time("canonical", [&]() {
+		for (const position& p : codes) sink += p.canonical().data()[0];
+	});
+
+#ifdef __BMI2__
+	std::cout << "bmi2 = yes";
+#else
+	std::cout << "bmi2 = no";
+#endif
+	std::cout << ", positions = " << positions.size() << ", bytes = " << sizeof(position) << std::endl;
+	std::cout << "verified = " << positions.size() << ", mismatches = " << mismatches << std::endl;
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * codec.h: Compact encoding of NoGo positions
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <array>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include "board.h"
+#include "bitboard.h"
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+/**
+ * a position in 19 bytes: the black stones and the white stones over the playable (non-hollow) points,
+ * 73 bits each, followed by 1 bit of the side to move (0 for black, 1 for white)
+ *
+ * the canonical code of a position is the least code among its 8 symmetric positions,
+ * which is valid since the hollow points are symmetric under rotation and reflection
+ */
+class position {
+public:
+	enum { points = board::size_x * board::size_y, bytes = 19 };
+	typedef bitboard::bits bits;
+
+public:
+	position() : code() {}
+	position(const bitboard& b) : position(b.black(), b.white(), b.who_take_turns()) {}
+	position(const board& b) : position(bitboard(b)) {}
+	position(bits black, bits white, unsigned who) : code() {
+		unsigned n = width();
+		bits lo = compress(black) | (compress(white) << n);
+		bits hi = (compress(white) >> (128 - n)) | (bits(who == board::white) << (n * 2 - 128));
+		std::memcpy(code.data(), &lo, 16);
+		std::memcpy(code.data() + 16, &hi, bytes - 16);
+	}
+
+public:
+	bits black() const { return expand(low() & ((bits(1) << width()) - 1)); }
+	bits white() const { return expand((low() >> width()) | (high() << (128 - width()))); }
+	unsigned who_take_turns() const { return (high() >> (width() * 2 - 128)) & 1 ? board::white : board::black; }
+
+	operator bitboard() const { return bitboard(black(), white(), who_take_turns()); }
+	explicit operator board() const {
+		board b;
+		board::grid& g = b;
+		bits black_stones = black(), white_stones = white();
+		for (unsigned i = 0; i < points; i++) {
+			if (black_stones & bitboard::bit(i)) g[i / board::size_y][i % board::size_y] = board::black;
+			if (white_stones & bitboard::bit(i)) g[i / board::size_y][i % board::size_y] = board::white;
+		}
+		b.info({ static_cast<board::piece_type>(who_take_turns()) });
+		return b;
+	}
+
+	/**
+	 * the position under the symmetry (s) of 8, where s & 1 reflects x, s & 2 reflects y, and s & 4 transposes
+	 */
+	position transform(unsigned s) const {
+		return position(permute(black(), s), permute(white(), s), who_take_turns());
+	}
+
+	/**
+	 * the canonical code, and the symmetry which maps this position to it
+	 */
+	position canonical(unsigned* symmetry = nullptr) const {
+		bits black_stones = black(), white_stones = white();
+		position best = *this;
+		unsigned pick = 0;
+		for (unsigned s = 1; s < 8; s++) {
+			position p(permute(black_stones, s), permute(white_stones, s), who_take_turns());
+			if (p < best) best = p, pick = s;
+		}
+		if (symmetry) *symmetry = pick;
+		return best;
+	}
+
+public:
+	const uint8_t* data() const { return code.data(); }
+	uint8_t* data() { return code.data(); }
+	size_t hash() const {
+		uint64_t lo, hi;
+		std::memcpy(&lo, code.data(), 8);
+		std::memcpy(&hi, code.data() + 8, 8);
+		return (lo ^ (hi * 0x9e3779b97f4a7c15ull)) * 0xff51afd7ed558ccdull;
+	}
+
+	bool operator ==(const position& p) const { return code == p.code; }
+	bool operator < (const position& p) const { return code <  p.code; }
+	bool operator !=(const position& p) const { return !(*this == p); }
+
+	friend std::ostream& operator <<(std::ostream& out, const position& p) {
+		const char* hex = "0123456789abcdef";
+		for (uint8_t c : p.code) out << hex[c >> 4] << hex[c & 15];
+		return out;
+	}
+	friend std::istream& operator >>(std::istream& in, position& p) {
+		std::string text;
+		if (in >> text && text.size() == bytes * 2 && text.find_first_not_of("0123456789abcdef") == std::string::npos) {
+			for (size_t i = 0; i < bytes; i++) p.code[i] = std::stoul(text.substr(i * 2, 2), nullptr, 16);
+		} else {
+			in.setstate(std::ios::failbit);
+		}
+		return in;
+	}
+
+protected:
+	static bits playable() { return bitboard(board()).empty(); }
+	static unsigned width() { static const unsigned n = bitboard::count(playable()); return n; } // 73, i.e., 64 < n and 2n + 1 <= 152
+
+	/**
+	 * gather the bits of b at the playable points into the low bits, i.e., PEXT over 128 bits
+	 * without BMI2, each column is packed by a lookup table instead
+	 */
+	static bits compress(bits b) {
+#ifdef __BMI2__
+		static const bits mask = playable();
+		uint64_t mask_lo = uint64_t(mask), mask_hi = uint64_t(mask >> 64);
+		uint64_t lo = _pext_u64(uint64_t(b), mask_lo), hi = _pext_u64(uint64_t(b >> 64), mask_hi);
+		return bits(lo) | (bits(hi) << __builtin_popcountll(mask_lo));
+#else
+		const columns& t = column_tables();
+		bits c = 0;
+		for (unsigned x = 0, n = 0; x < board::size_x; n += t.width[x++]) {
+			c |= bits(t.pack[x][unsigned(b >> (x * board::size_y)) & t.full]) << n;
+		}
+		return c;
+#endif
+	}
+
+	/**
+	 * scatter the low bits of c to the playable points, i.e., PDEP over 128 bits
+	 */
+	static bits expand(bits c) {
+#ifdef __BMI2__
+		static const bits mask = playable();
+		uint64_t mask_lo = uint64_t(mask), mask_hi = uint64_t(mask >> 64);
+		uint64_t lo = _pdep_u64(uint64_t(c), mask_lo), hi = _pdep_u64(uint64_t(c >> __builtin_popcountll(mask_lo)), mask_hi);
+		return bits(lo) | (bits(hi) << 64);
+#else
+		const columns& t = column_tables();
+		bits b = 0;
+		for (unsigned x = 0; x < board::size_x; c >>= t.width[x++]) {
+			b |= bits(t.unpack[x][unsigned(c) & ((1u << t.width[x]) - 1)]) << (x * board::size_y);
+		}
+		return b;
+#endif
+	}
+
+	struct columns {
+		enum { full = (1u << board::size_y) - 1 };
+		std::array<std::array<uint16_t, full + 1>, board::size_x> pack;
+		std::array<std::array<uint16_t, full + 1>, board::size_x> unpack;
+		std::array<unsigned, board::size_x> width;
+	};
+	static const columns& column_tables() {
+		static const columns t = []() {
+			columns t = {};
+			for (unsigned x = 0; x < board::size_x; x++) {
+				unsigned mask = unsigned(playable() >> (x * board::size_y)) & columns::full;
+				t.width[x] = __builtin_popcount(mask);
+				for (unsigned v = 0; v <= columns::full; v++) {
+					unsigned packed = 0, k = 0;
+					for (unsigned y = 0; y < board::size_y; y++) {
+						if (mask & (1u << y)) packed |= ((v >> y) & 1) << k++;
+					}
+					t.pack[x][v] = packed;
+					if (v < (1u << t.width[x])) {
+						unsigned spread = 0;
+						k = 0;
+						for (unsigned y = 0; y < board::size_y; y++) {
+							if (mask & (1u << y)) spread |= ((v >> k++) & 1) << y;
+						}
+						t.unpack[x][v] = spread;
+					}
+				}
+			}
+			return t;
+		}();
+		return t;
+	}
+
+	/**
+	 * move the stones of b by the symmetry (s)
+	 */
+	static bits permute(bits b, unsigned s) {
+		static const std::array<std::array<uint8_t, points>, 8> table = []() {
+			std::array<std::array<uint8_t, points>, 8> t;
+			for (unsigned s = 0; s < 8; s++) {
+				for (unsigned i = 0; i < points; i++) {
+					unsigned x = i / board::size_y, y = i % board::size_y;
+					if (s & 1) x = board::size_x - 1 - x;
+					if (s & 2) y = board::size_y - 1 - y;
+					if (s & 4) std::swap(x, y);
+					t[s][i] = x * board::size_y + y;
+				}
+			}
+			return t;
+		}();
+		bits res = 0;
+		for (; b; b &= b - 1) res |= bitboard::bit(table[s][bitboard::select(b, 0)]);
+		return res;
+	}
+
+	bits low() const {
+		bits lo;
+		std::memcpy(&lo, code.data(), 16);
+		return lo;
+	}
+	bits high() const {
+		bits hi = 0;
+		std::memcpy(&hi, code.data() + 16, bytes - 16);
+		return hi;
+	}
+
+private:
+	std::array<uint8_t, bytes> code;
+};
@@ -0,0 +1,300 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * egtable.h: Canonical region patterns and precomputed endgame tables
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include "board.h"
+#include "bitboard.h"
+#include "cgt.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * a region abstracted from the board: its empty points, and the blocks next to them
+ *
+ * a block is kept as its color and its liberties, since this is all that a move inside the region can see,
+ * thus regions of the same shape with the same liberty sets have the same game value wherever they are
+ * the points are indexed in order, and the liberties are a mask over the indexes
+ */
+struct pattern {
+	typedef uint32_t mask;
+	std::vector<std::pair<int, int>> points;
+	std::vector<std::pair<unsigned, mask>> blocks;
+
+	pattern() {}
+	pattern(bitboard::bits space, bitboard::bits black, bitboard::bits white) {
+		int index[board::size_x * board::size_y];
+		for (bitboard::bits rest = space; rest; rest &= rest - 1) {
+			unsigned i = bitboard::select(rest, 0);
+			index[i] = int(points.size());
+			points.emplace_back(i / board::size_y, i % board::size_y);
+		}
+		for (unsigned who : { board::black, board::white }) {
+			bitboard::bits stones = who == board::black ? black : white;
+			for (bitboard::bits rest = stones; rest; ) {
+				bitboard::bits block = bitboard::connect(rest & -rest, stones);
+				rest &= ~block;
+				mask libs = 0;
+				for (bitboard::bits lib = bitboard::neighbors(block) & space; lib; lib &= lib - 1)
+					libs |= mask(1) << index[bitboard::select(lib, 0)];
+				blocks.emplace_back(who, libs);
+			}
+		}
+		normalize();
+	}
+
+public:
+	size_t size() const { return points.size(); }
+
+	/**
+	 * the empty points next to the point (i)
+	 */
+	mask adjacent(size_t i) const {
+		mask adj = 0;
+		for (size_t j = 0; j < points.size(); j++) {
+			int dx = points[i].first - points[j].first, dy = points[i].second - points[j].second;
+			if (dx * dx + dy * dy == 1) adj |= mask(1) << j;
+		}
+		return adj;
+	}
+
+	/**
+	 * whether who may play at the point (i), by the same rule as bitboard::legal
+	 */
+	bool legal(size_t i, unsigned who) const {
+		mask p = mask(1) << i;
+		bool breath = adjacent(i);
+		for (const auto& b : blocks) {
+			if (!(b.second & p)) continue;
+			bool last = !(b.second & ~p);
+			if (b.first != who && last) return false;
+			if (b.first == who && !last) breath = true;
+		}
+		return breath;
+	}
+
+	/**
+	 * the pattern after who plays at the point (i), which is known to be legal
+	 */
+	pattern place(size_t i, unsigned who) const {
+		mask p = mask(1) << i;
+		mask merge = adjacent(i);
+		pattern next;
+		for (size_t j = 0; j < points.size(); j++) {
+			if (j != i) next.points.push_back(points[j]);
+		}
+		for (const auto& b : blocks) {
+			if (b.first == who && (b.second & p)) merge |= b.second;
+			else next.blocks.emplace_back(b.first, remove(b.second, i));
+		}
+		next.blocks.emplace_back(who, remove(merge, i));
+		next.normalize();
+		return next;
+	}
+
+	/**
+	 * the canonical key, which is the same for the patterns equal under rotation, reflection and translation
+	 * 0 is never used as a key
+	 */
+	uint64_t key() const {
+		std::vector<uint32_t> best;
+		for (int t = 0; t < 8; t++) {
+			std::vector<std::pair<std::pair<int, int>, size_t>> order;
+			int min_x = 1 << 30, min_y = 1 << 30;
+			for (size_t i = 0; i < points.size(); i++) {
+				int x = points[i].first, y = points[i].second;
+				if (t & 1) x = -x;
+				if (t & 2) y = -y;
+				if (t & 4) std::swap(x, y);
+				order.push_back({ { x, y }, i });
+				min_x = std::min(min_x, x);
+				min_y = std::min(min_y, y);
+			}
+			std::sort(order.begin(), order.end());
+			std::vector<size_t> index(points.size());
+			std::vector<uint32_t> code = { uint32_t(points.size()) };
+			for (size_t i = 0; i < order.size(); i++) {
+				index[order[i].second] = i;
+				code.push_back(uint32_t(order[i].first.first - min_x) << 16 | uint32_t(order[i].first.second - min_y));
+			}
+			std::vector<uint32_t> libs;
+			for (const auto& b : blocks) {
+				mask m = 0;
+				for (size_t i = 0; i < points.size(); i++) {
+					if (b.second & (mask(1) << i)) m |= mask(1) << index[i];
+				}
+				libs.push_back(uint32_t(b.first) << 30 | m);
+			}
+			std::sort(libs.begin(), libs.end());
+			code.insert(code.end(), libs.begin(), libs.end());
+			if (best.empty() || code < best) best = code;
+		}
+		uint64_t h = 0xcbf29ce484222325ull;
+		for (uint32_t w : best) h = (h ^ w) * 0x100000001b3ull, h ^= h >> 32;
+		return h ? h : 1;
+	}
+
+protected:
+	static mask remove(mask m, size_t i) {
+		return (m & ((mask(1) << i) - 1)) | ((m >> (i + 1)) << i);
+	}
+
+	/**
+	 * blocks of the same color with the same liberties are indistinguishable, so only one of them is kept
+	 */
+	void normalize() {
+		std::sort(blocks.begin(), blocks.end());
+		blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+	}
+};
+
+/**
+ * a read-only endgame table, which maps the keys of patterns to their canonical game values
+ * the file is mapped into memory as it is, and a lookup is a probe into an open addressing hash table
+ *
+ * layout: header, node[games], uint32_t option[options] (padded to 8 bytes), slot[slots]
+ * the options of a node are indexes of other nodes, and node 0 is the zero game
+ */
+class egtable {
+public:
+	struct header {
+		char magic[8];
+		uint32_t version;
+		uint32_t limit;
+		uint64_t games;
+		uint64_t options;
+		uint64_t entries;
+		uint64_t slots;
+	};
+	struct node {
+		uint32_t left, num_left;
+		uint32_t right, num_right;
+	};
+	struct slot {
+		uint64_t key;
+		uint32_t game;
+		uint32_t reserved;
+	};
+
+public:
+	egtable(const std::string& path) : base(nullptr), length(0) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) != 0) {
+			if (fd >= 0) ::close(fd);
+			throw std::runtime_error("cannot open endgame table " + path);
+		}
+		length = st.st_size;
+		void* map = length ? mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if (map == MAP_FAILED) throw std::runtime_error("cannot map endgame table " + path);
+		base = static_cast<const char*>(map);
+		if (length < sizeof(header) || std::memcmp(head().magic, "NOGOEGTB", 8) != 0 || head().version != 1
+				|| length < offset_slots() + head().slots * sizeof(slot)) {
+			munmap(const_cast<char*>(base), length);
+			throw std::runtime_error("bad endgame table " + path);
+		}
+	}
+	egtable(const egtable&) = delete;
+	egtable& operator =(const egtable&) = delete;
+	~egtable() { munmap(const_cast<char*>(base), length); }
+
+public:
+	/**
+	 * the largest number of empty points of the regions in the table
+	 */
+	size_t limit() const { return head().limit; }
+	size_t games() const { return head().games; }
+	size_t entries() const { return head().entries; }
+
+	/**
+	 * the game of the pattern with the given key, or -1 if the pattern is not in the table
+	 */
+	int find(uint64_t key) const {
+		const slot* table = slots();
+		uint64_t mask = head().slots - 1;
+		for (uint64_t i = key & mask; table[i].key; i = (i + 1) & mask) {
+			if (table[i].key == key) return int(table[i].game);
+		}
+		return -1;
+	}
+
+	/**
+	 * the options of a game
+	 */
+	std::vector<int> left(int g) const {
+		const node& n = nodes()[g];
+		return std::vector<int>(options() + n.left, options() + n.left + n.num_left);
+	}
+	std::vector<int> right(int g) const {
+		const node& n = nodes()[g];
+		return std::vector<int>(options() + n.right, options() + n.right + n.num_right);
+	}
+
+public:
+	/**
+	 * write a table of the games of a store, and the keys of the patterns with their games
+	 */
+	static void write(const std::string& path, size_t limit, const cgt& store, const std::vector<std::pair<uint64_t, int>>& entries) {
+		header h = {};
+		std::memcpy(h.magic, "NOGOEGTB", 8);
+		h.version = 1;
+		h.limit = uint32_t(limit);
+		h.games = store.size();
+		std::vector<node> node_list;
+		std::vector<uint32_t> option_list;
+		for (size_t g = 0; g < store.size(); g++) {
+			const cgt::game& game = store.at(g);
+			node n = { uint32_t(option_list.size()), uint32_t(game.left.size()), 0, 0 };
+			option_list.insert(option_list.end(), game.left.begin(), game.left.end());
+			n.right = uint32_t(option_list.size());
+			n.num_right = uint32_t(game.right.size());
+			option_list.insert(option_list.end(), game.right.begin(), game.right.end());
+			node_list.push_back(n);
+		}
+		h.options = option_list.size();
+		if (option_list.size() % 2) option_list.push_back(0);
+		h.entries = entries.size();
+		for (h.slots = 2; h.slots < entries.size() * 2; h.slots *= 2);
+		std::vector<slot> slot_list(h.slots);
+		for (const auto& e : entries) {
+			uint64_t i = e.first & (h.slots - 1);
+			while (slot_list[i].key && slot_list[i].key != e.first) i = (i + 1) & (h.slots - 1);
+			slot_list[i] = { e.first, uint32_t(e.second), 0 };
+		}
+		std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+		out.write(reinterpret_cast<const char*>(node_list.data()), node_list.size() * sizeof(node));
+		out.write(reinterpret_cast<const char*>(option_list.data()), option_list.size() * sizeof(uint32_t));
+		out.write(reinterpret_cast<const char*>(slot_list.data()), slot_list.size() * sizeof(slot));
+		if (!out) throw std::runtime_error("cannot write endgame table " + path);
+	}
+
+protected:
+	const header& head() const { return *reinterpret_cast<const header*>(base); }
+	const node* nodes() const { return reinterpret_cast<const node*>(base + sizeof(header)); }
+	const uint32_t* options() const { return reinterpret_cast<const uint32_t*>(base + sizeof(header) + head().games * sizeof(node)); }
+	const slot* slots() const { return reinterpret_cast<const slot*>(base + offset_slots()); }
+	size_t offset_slots() const {
+		return sizeof(header) + head().games * sizeof(node) + (head().options + head().options % 2) * sizeof(uint32_t);
+	}
+
+private:
+	const char* base;
+	size_t length;
+};
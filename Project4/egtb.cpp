@@ -0,0 +1,264 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * egtb.cpp: Generator of the endgame tables for small regions
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include "board.h"
+#include "cgt.h"
+#include "egtable.h"
+#include "threads.h"
+#include <unistd.h>
+
+/**
+ * exact values of patterns, solved by memoised search over the patterns themselves
+ * the patterns solved for the first time are kept in fresh, i.e., every position met by the search is a table entry
+ */
+class egsolver : public cgt {
+public:
+	int value(const pattern& p) {
+		uint64_t key = p.key();
+		auto it = memo.find(key);
+		if (it != memo.end()) return it->second;
+		std::vector<int> left, right;
+		for (size_t i = 0; i < p.size(); i++) {
+			if (p.legal(i, board::black)) left.push_back(value(p.place(i, board::black)));
+			if (p.legal(i, board::white)) right.push_back(value(p.place(i, board::white)));
+		}
+		int g = canonical(left, right);
+		fresh.emplace_back(key, g);
+		return memo[key] = g;
+	}
+
+	/**
+	 * the index of { left | right }, which is already canonical
+	 */
+	int intern(const std::vector<int>& left, const std::vector<int>& right) { return form(left, right); }
+
+	/**
+	 * write the fresh patterns as a self-contained chunk of the journal, with the games they need
+	 */
+	void flush(std::ostream& out, size_t shape) {
+		std::map<int, int> local;
+		std::function<int(int)> emit = [&](int g) -> int {
+			auto it = local.find(g);
+			if (it != local.end()) return it->second;
+			std::vector<int> left, right;
+			for (int opt : std::vector<int>(games[g].left))  left.push_back(emit(opt));
+			for (int opt : std::vector<int>(games[g].right)) right.push_back(emit(opt));
+			out << "form " << left.size();
+			for (int opt : left) out << ' ' << opt;
+			out << ' ' << right.size();
+			for (int opt : right) out << ' ' << opt;
+			out << std::endl;
+			int id = int(local.size());
+			return local[g] = id;
+		};
+		out << "shape " << shape << std::endl;
+		for (const auto& e : fresh) {
+			int id = emit(e.second);
+			out << "entry " << e.first << ' ' << id << std::endl;
+		}
+		out << "end" << std::endl;
+		fresh.clear();
+	}
+
+private:
+	std::unordered_map<uint64_t, int> memo;
+	std::vector<std::pair<uint64_t, int>> fresh;
+};
+
+typedef std::vector<std::pair<int, int>> shape;
+
+/**
+ * the free polyominoes with at most n cells, each of which is given once in a fixed order
+ */
+std::vector<shape> polyominoes(size_t n) {
+	std::vector<shape> list, level = { shape{ { 0, 0 } } };
+	while (level.size() && level.front().size() <= n) {
+		list.insert(list.end(), level.begin(), level.end());
+		std::set<uint64_t> seen;
+		std::vector<shape> next;
+		for (const shape& cells : level) {
+			for (const auto& c : cells) {
+				for (auto d : { std::make_pair(1, 0), std::make_pair(-1, 0), std::make_pair(0, 1), std::make_pair(0, -1) }) {
+					auto add = std::make_pair(c.first + d.first, c.second + d.second);
+					if (std::find(cells.begin(), cells.end(), add) != cells.end()) continue;
+					pattern p;
+					p.points = cells;
+					p.points.push_back(add);
+					if (seen.insert(p.key()).second) next.push_back(p.points);
+				}
+			}
+		}
+		level = next;
+	}
+	return list;
+}
+
+/**
+ * solve every context of a shape, i.e., every set of blocks next to it, where a point is next to a block
+ * only through its sides that are not next to another point of the shape
+ */
+void solve(egsolver& solver, const shape& cells) {
+	pattern p;
+	p.points = cells;
+	std::vector<int> sides(cells.size());
+	for (size_t i = 0; i < cells.size(); i++) sides[i] = 4 - __builtin_popcount(p.adjacent(i));
+	std::vector<std::pair<unsigned, pattern::mask>> candidates;
+	for (unsigned who : { board::black, board::white }) {
+		for (pattern::mask m = 1; m < (pattern::mask(1) << cells.size()); m++) {
+			bool fit = true;
+			for (size_t i = 0; i < cells.size(); i++) fit &= !(m & (1u << i)) || sides[i] > 0;
+			if (fit) candidates.emplace_back(who, m);
+		}
+	}
+	std::function<void(size_t)> assign = [&](size_t k) {
+		if (k == candidates.size()) {
+			pattern q = p;
+			std::sort(q.blocks.begin(), q.blocks.end());
+			solver.value(q);
+			return;
+		}
+		assign(k + 1);
+		pattern::mask m = candidates[k].second;
+		for (size_t i = 0; i < cells.size(); i++) {
+			if ((m & (1u << i)) && sides[i] == 0) return;
+		}
+		for (size_t i = 0; i < cells.size(); i++) sides[i] -= (m >> i) & 1;
+		p.blocks.push_back(candidates[k]);
+		assign(k + 1);
+		p.blocks.pop_back();
+		for (size_t i = 0; i < cells.size(); i++) sides[i] += (m >> i) & 1;
+	};
+	assign(0);
+}
+
+int main(int argc, const char* argv[]) {
+	std::cout << "HollowNoGo-EGTB: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cout, " "));
+	std::cout << std::endl << std::endl;
+
+	size_t size = 4;
+	std::string out_path = "nogo.egtb", journal_path;
+	std::string threads = "1", affinity, numa; // for worker threads
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto match_arg = [&](std::string flag) -> bool {
+			auto it = arg.find_first_not_of('-');
+			return arg.find(flag, it) == it;
+		};
+		auto next_opt = [&]() -> std::string {
+			auto it = arg.find('=') + 1;
+			return it ? arg.substr(it) : argv[++i];
+		};
+		if (match_arg("size")) {
+			size = std::stoull(next_opt());
+		} else if (match_arg("out")) {
+			out_path = next_opt();
+		} else if (match_arg("journal")) {
+			journal_path = next_opt();
+		} else if (match_arg("threads")) {
+			threads = next_opt();
+		} else if (match_arg("affinity")) {
+			affinity = next_opt();
+		} else if (match_arg("numa")) {
+			numa = next_opt();
+		}
+	}
+	if (journal_path.empty()) journal_path = out_path + ".journal";
+	if (size > 16) size = 16;
+
+	std::vector<shape> shapes = polyominoes(size);
+
+	/**
+	 * the journal is a list of chunks, one per finished shape, thus the generation resumes from the shapes
+	 * which have no complete chunk, and a chunk cut short by an interruption is dropped
+	 * return the length of the journal up to the last complete chunk
+	 */
+	auto replay = [&](std::function<void(size_t, const std::vector<std::string>&)> chunk) -> off_t {
+		std::ifstream in(journal_path);
+		std::vector<std::string> lines;
+		size_t current = -1;
+		off_t length = 0;
+		for (std::string line; std::getline(in, line); ) {
+			if (line.compare(0, 6, "shape ") == 0) {
+				current = std::stoull(line.substr(6));
+				lines.clear();
+			} else if (line == "end" && current != size_t(-1) && !in.eof()) {
+				chunk(current, lines);
+				current = -1;
+				length = in.tellg();
+			} else {
+				lines.push_back(line);
+			}
+		}
+		return length;
+	};
+	std::set<size_t> done;
+	off_t length = replay([&](size_t s, const std::vector<std::string>&) { done.insert(s); });
+	if (std::ifstream(journal_path).good() && truncate(journal_path.c_str(), length) != 0) {
+		std::cerr << "cannot resume from " << journal_path << std::endl;
+		return 1;
+	}
+	std::cout << shapes.size() << " shapes, " << done.size() << " done" << std::endl;
+
+	workers pool(threads, affinity, numa);
+	std::ofstream journal(journal_path, std::ios::out | std::ios::app);
+	std::atomic<size_t> next(0);
+	std::mutex lock;
+	pool.run([&](size_t id) {
+		egsolver solver;
+		for (size_t s; (s = next++) < shapes.size(); ) {
+			if (done.count(s)) continue;
+			solve(solver, shapes[s]);
+			std::stringstream chunk;
+			solver.flush(chunk, s);
+			std::lock_guard<std::mutex> guard(lock);
+			journal << chunk.str() << std::flush;
+		}
+	});
+	journal.close();
+
+	egsolver table;
+	std::unordered_map<uint64_t, int> entries;
+	replay([&](size_t, const std::vector<std::string>& lines) {
+		std::vector<int> local;
+		for (const std::string& line : lines) {
+			std::stringstream ss(line);
+			std::string type;
+			ss >> type;
+			if (type == "form") {
+				std::vector<int> left, right;
+				size_t n;
+				int opt;
+				for (ss >> n; n-- && ss >> opt; ) left.push_back(local.at(opt));
+				for (ss >> n; n-- && ss >> opt; ) right.push_back(local.at(opt));
+				local.push_back(table.intern(left, right));
+			} else if (type == "entry") {
+				uint64_t key;
+				int opt;
+				ss >> key >> opt;
+				entries[key] = local.at(opt);
+			}
+		}
+	});
+	egtable::write(out_path, size, table, std::vector<std::pair<uint64_t, int>>(entries.begin(), entries.end()));
+	std::cout << entries.size() << " patterns, " << table.size() << " games, saved to " << out_path << std::endl;
+	return 0;
+}
@@ -0,0 +1,243 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * endgame.h: Region decomposition and exact solving of NoGo endgames
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include "board.h"
+#include "bitboard.h"
+#include "cgt.h"
+#include "egtable.h"
+
+/**
+ * exact endgame solver based on combinatorial game theory
+ *
+ * the empty points are split into regions which no block of stones connects, since a move only affects the blocks
+ * next to it, the regions evolve independently and the position is the sum of the regions
+ * each region is solved by a memoised local search into its canonical form (black is Left, white is Right),
+ * and the sum is searched over the canonical forms, which are far smaller than the regions themselves
+ * the regions found in a precomputed endgame table are looked up instead of searched
+ */
+class endgame : public cgt {
+public:
+	typedef bitboard::bits bits;
+	typedef std::chrono::steady_clock clock;
+
+	endgame(const egtable* table = nullptr) : table(table) {}
+
+	/**
+	 * a region: its empty points, and the blocks next to them
+	 */
+	struct region {
+		bits space;
+		bits black;
+		bits white;
+		bool operator ==(const region& r) const { return space == r.space && black == r.black && white == r.white; }
+	};
+
+public:
+	/**
+	 * split the position into independent regions
+	 */
+	static std::vector<region> regions(const bitboard& b) {
+		return regions(b.empty(), b.black(), b.white());
+	}
+	static std::vector<region> regions(bits space, bits black, bits white) {
+		std::vector<region> list;
+		for (bits rest = space; rest; ) {
+			bits part = rest & -rest;
+			for (bits grow; ; part = grow) { // grow through the empty points, and through the blocks next to them
+				grow = part | (bitboard::neighbors(part & ~white) & (space | black))
+				            | (bitboard::neighbors(part & ~black) & (space | white));
+				if (grow == part) break;
+			}
+			rest &= ~part;
+			list.push_back({ part & space, part & black, part & white });
+		}
+		return list;
+	}
+
+	/**
+	 * find a winning move for the side to move, searching until the deadline
+	 * return the point, or -1 if the position is lost, or -2 if a region has more than limit empty points
+	 * or the deadline has passed, where the caller should fall back to another search
+	 */
+	int solve(const board& state, size_t limit, clock::time_point deadline = clock::time_point::max()) {
+		bitboard b(state);
+		unsigned who = b.who_take_turns();
+		std::vector<region> list = regions(b);
+		for (const region& r : list) {
+			if (bitboard::count(r.space) > limit) return -2;
+		}
+		this->deadline = deadline;
+		aborted = false;
+		parts.clear();
+		key = 0;
+		std::vector<int> values;
+		for (const region& r : list) values.push_back(push(value(r)));
+		for (size_t i = 0; i < list.size() && !aborted; i++) {
+			const region& r = list[i];
+			bits own = who == board::black ? r.black : r.white;
+			bits opp = who == board::black ? r.white : r.black;
+			for (bits moves = bitboard::legal(own, opp, r.space); moves && !aborted; moves &= moves - 1) {
+				bits p = moves & -moves;
+				// the move may split the region, whose parts are then added to the sum independently
+				bits black = who == board::black ? r.black | p : r.black;
+				bits white = who == board::white ? r.white | p : r.white;
+				pop(values[i]);
+				std::vector<int> next;
+				for (const region& part : regions(r.space & ~p, black, white)) next.push_back(push(value(part)));
+				bool win = !wins(3u - who);
+				for (int g : next) pop(g);
+				push(values[i]);
+				if (win && !aborted) return bitboard::select(p, 0);
+			}
+		}
+		return aborted ? -2 : -1;
+	}
+
+	/**
+	 * whether the side to move wins the sum of the canonical games in parts
+	 * the outcomes are cached by the Zobrist key of the sum, i.e., the sum of the keys of its games, so that
+	 * the same sum reached in any order, in this search or in those of the later moves, is searched only once
+	 */
+	bool wins(unsigned who) {
+		uint64_t k = key ^ (who == board::white ? zobrist(-1) : 0);
+		auto it = outcome.find(k);
+		if (it != outcome.end()) return it->second;
+		if (expired()) return false;
+		bool win = false;
+		for (size_t i = 0; i < parts.size() && !win; i++) {
+			int g = parts[i];
+			if (std::find(parts.begin(), parts.begin() + i, g) != parts.begin() + i) continue; // the same game as an earlier part
+			const std::vector<int>& options = who == board::black ? games[g].left : games[g].right;
+			for (size_t n = 0; n < options.size() && !win; n++) {
+				int opt = options[n];
+				parts[i] = opt; // a part which has become zero stays as 0, which has no options and no key
+				key += zobrist(opt) - zobrist(g);
+				win = !wins(3u - who);
+				key -= zobrist(opt) - zobrist(g);
+				parts[i] = g;
+			}
+		}
+		if (aborted) return false;
+		return outcome[k] = win;
+	}
+
+	/**
+	 * the canonical form of a region, solved by local search
+	 */
+	int value(const region& at) {
+		region r = corner(at);
+		auto it = local.find(r);
+		if (it != local.end()) return it->second;
+		if (table && bitboard::count(r.space) <= table->limit()) {
+			int g = table->find(pattern(r.space, r.black, r.white).key());
+			if (g >= 0) return local[r] = import(g);
+		}
+		if (expired()) return 0;
+		std::vector<int> left, right;
+		for (bits moves = bitboard::legal(r.black, r.white, r.space); moves; moves &= moves - 1) {
+			bits p = moves & -moves;
+			left.push_back(split({ r.space & ~p, r.black | p, r.white }));
+		}
+		for (bits moves = bitboard::legal(r.white, r.black, r.space); moves; moves &= moves - 1) {
+			bits p = moves & -moves;
+			right.push_back(split({ r.space & ~p, r.black, r.white | p }));
+		}
+		if (aborted) return 0; // the options are incomplete
+		return local[r] = canonical(left, right);
+	}
+
+	/**
+	 * the region moved toward A1 as far as it goes, which has the same value since nothing outside it matters,
+	 * so that the regions of the same shape are searched once wherever they are
+	 */
+	static region corner(const region& r) {
+		bits all = r.space | r.black | r.white, rows = 0;
+		for (unsigned x = 0; x < board::size_x; x++) rows |= all >> (x * board::size_y);
+		unsigned shift = bitboard::select(all, 0) / board::size_y * board::size_y + bitboard::select(rows & ((bits(1) << board::size_y) - 1), 0);
+		return { r.space >> shift, r.black >> shift, r.white >> shift };
+	}
+
+	/**
+	 * the canonical form of a region after a move, which may have split it into smaller regions
+	 */
+	int split(const region& r) {
+		int g = 0;
+		for (const region& part : regions(r.space, r.black, r.white)) g = add(g, value(part));
+		return g;
+	}
+
+	/**
+	 * the game (g) of the table as a game of this store
+	 */
+	int import(int g) {
+		if (imported.size() < table->games()) imported.resize(table->games(), -1);
+		if (imported[g] != -1) return imported[g];
+		std::vector<int> left, right;
+		for (int opt : table->left(g))  left.push_back(import(opt));
+		for (int opt : table->right(g)) right.push_back(import(opt));
+		return imported[g] = form(left, right);
+	}
+
+protected:
+	/**
+	 * add a game to the sum, or remove it, keeping the key of the sum
+	 */
+	int push(int g) {
+		if (g) parts.push_back(g), key += zobrist(g);
+		return g;
+	}
+	void pop(int g) {
+		if (g) parts.erase(std::find(parts.begin(), parts.end(), g)), key -= zobrist(g);
+	}
+
+	/**
+	 * the random key of a game, where the zero game has none, and zobrist(-1) is the key of white to move
+	 */
+	static uint64_t zobrist(int g) {
+		if (g == 0) return 0;
+		uint64_t z = uint64_t(g) * 0x9e3779b97f4a7c15ull;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	/**
+	 * whether the deadline has passed, checked once every 64 calls
+	 */
+	bool expired() {
+		if (!aborted && (++nodes & 63) == 0 && clock::now() > deadline) aborted = true;
+		return aborted;
+	}
+
+private:
+	struct region_hash {
+		size_t operator ()(const region& r) const {
+			uint64_t h = 0;
+			for (bits b : { r.space, r.black, r.white }) {
+				h = (h ^ uint64_t(b)) * 0x9e3779b97f4a7c15ull;
+				h = (h ^ uint64_t(b >> 64)) * 0x9e3779b97f4a7c15ull;
+			}
+			return h ^ (h >> 29);
+		}
+	};
+	std::unordered_map<region, int, region_hash> local;
+	std::unordered_map<uint64_t, bool> outcome;
+	const egtable* table;
+	std::vector<int> imported;
+	std::vector<int> parts; // the nonzero games of the sum being searched
+	uint64_t key = 0;
+	clock::time_point deadline;
+	size_t nodes = 0;
+	bool aborted = false;
+};
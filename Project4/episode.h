@@ -15,6 +15,7 @@
 #include <sstream>
 #include <chrono>
 #include <numeric>
+#include <cctype>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
@@ -43,6 +44,20 @@ public:
 		ep_score += reward;
 		return true;
 	}
+	/**
+	 * take back the last move, which is exact since a move of NoGo never captures
+	 * return false if there is no move to take back
+	 */
+	bool undo_action() {
+		if (ep_moves.empty()) return false;
+		action::place move = ep_moves.back().code;
+		board::point p = move.position();
+		state()[p.x][p.y] = board::empty;
+		state().info({ move.color() });
+		ep_score -= ep_moves.back().reward;
+		ep_moves.pop_back();
+		return true;
+	}
 	agent& take_turns(agent& black, agent& white) {
 		ep_time = millisec();
 		return (step() % 2) ? white : black;
@@ -102,6 +117,79 @@ public:
 		return res;
 	}
 
+	/**
+	 * the time spent by each move, in the same order as actions()
+	 */
+	std::vector<time_t> times(unsigned who = -1u) const {
+		std::vector<time_t> res;
+		switch (who) {
+		case board::black:
+		case action::black::type:
+			for (size_t i = 0; i < ep_moves.size(); i += 2) res.push_back(ep_moves[i].time);
+			break;
+		case board::white:
+		case action::white::type:
+			for (size_t i = 1; i < ep_moves.size(); i += 2) res.push_back(ep_moves[i].time);
+			break;
+		case action::place::type:
+		default:
+			for (const move& mv : ep_moves) res.push_back(mv.time);
+			break;
+		}
+		return res;
+	}
+
+	/**
+	 * the tags given when the episode is opened and closed, e.g., the names of the players and the winner
+	 */
+	const std::string& open_tag() const { return ep_open.tag; }
+	const std::string& close_tag() const { return ep_close.tag; }
+
+public:
+	/**
+	 * the moves of an SGF record, i.e., its nodes like ;B[aa] or ;W[aa], up to but not including the until-th move
+	 */
+	static std::vector<action::place> parse_moves(const std::string& sgf, size_t until = -1) {
+		std::vector<action::place> moves;
+		for (size_t i = 0; i + 5 < sgf.size() && moves.size() + 1 < until; i++) {
+			if (sgf[i] != ';') continue;
+			action::place move;
+			std::stringstream node(sgf.substr(i, 6));
+			if (node >> move && move.color() != board::empty) moves.push_back(move);
+		}
+		return moves;
+	}
+
+	/**
+	 * whether an SGF record is only a sequence of moves, i.e., without setup stones (AB, AW, or AE) and without passes (e.g., B[] or B[tt]),
+	 * since parse_moves takes only the moves on the board, and such a record would be loaded as a different position
+	 */
+	static bool plain_moves(const std::string& sgf) {
+		std::string name;
+		bool valued = false; // whether the last property has a value, so that a letter starts another property
+		for (size_t i = 0; i < sgf.size(); i++) {
+			char ch = sgf[i];
+			if (std::isupper(static_cast<unsigned char>(ch))) {
+				if (valued) name.clear();
+				name += ch;
+				valued = false;
+			} else if (ch == '[') {
+				size_t end = i + 1;
+				while (end < sgf.size() && sgf[end] != ']') end += sgf[end] == '\\' ? 2 : 1;
+				std::string value = sgf.substr(i + 1, end - i - 1);
+				if (name == "AB" || name == "AW" || name == "AE") return false;
+				if ((name == "B" || name == "W") && (value.size() != 2
+					|| unsigned(value[0] - 'a') >= board::size_x || unsigned(value[1] - 'a') >= board::size_y)) return false;
+				valued = true;
+				i = end;
+			} else if (!std::isspace(static_cast<unsigned char>(ch))) {
+				name.clear();
+				valued = false;
+			}
+		}
+		return true;
+	}
+
 public:
 
 	friend std::ostream& operator <<(std::ostream& out, const episode& ep) {
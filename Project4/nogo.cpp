@@ -11,11 +11,15 @@
 #include <fstream>
 #include <iterator>
 #include <string>
+#include <mutex>
+#include <chrono>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
 #include "episode.h"
 #include "statistics.h"
+#include "threads.h"
+#include "alloc.h"
 
 int main(int argc, const char* argv[]) {
 	std::cout << "HollowNoGo-Demo: ";
@@ -25,8 +29,10 @@ int main(int argc, const char* argv[]) {
 	size_t total = 1000, block = 0, limit = 0;
 	std::string black_args, white_args;
 	std::string load_path, save_path;
+	std::string threads = "1", affinity, numa; // for worker threads
 	std::string name = "TCG-HollowNoGo-Demo", version = "2022"; // for GTP shell
 	bool shell = false;
+	std::string record_path; // the GTP session record
 	for (int i = 1; i < argc; i++) {
 		std::string arg = argv[i];
 		auto match_arg = [&](std::string flag) -> bool {
@@ -55,8 +61,16 @@ int main(int argc, const char* argv[]) {
 			name = next_opt();
 		} else if (match_arg("version")) {
 			version = next_opt();
+		} else if (match_arg("threads")) {
+			threads = next_opt();
+		} else if (match_arg("affinity")) {
+			affinity = next_opt();
+		} else if (match_arg("numa")) {
+			numa = next_opt();
 		} else if (match_arg("shell")) {
 			shell = true;
+		} else if (match_arg("record")) {
+			record_path = next_opt();
 		}
 	}
 
@@ -69,51 +83,136 @@ int main(int argc, const char* argv[]) {
 		if (stats.is_finished()) stats.summary();
 	}
 
+	workers pool(threads, affinity, numa);
 	player black("name=black " + black_args + " role=black");
 	player white("name=white " + white_args + " role=white");
+	black.pin(pool, 0);
+	white.pin(pool, 0);
 
-	if (!shell) { // launch standard local games
+	auto play = [](player& black, player& white, episode& game) -> std::string {
+		while (true) {
+			agent& who = game.take_turns(black, white);
+			action move;
+			{
+				allocation::phase scope("search");
+				move = who.take_action(game.state());
+			}
+//			std::cerr << game.state() << "#" << game.step() << " " << who.name() << ": " << move << std::endl;
+			allocation::phase scope("record");
+			if (game.apply_action(move) != true) break;
+			if (who.check_for_win(game.state())) break;
+		}
+		return game.last_turns(black, white).name();
+	};
+
+	if (!shell && pool.size() == 1) { // launch standard local games
+		pool.pin(0);
 		while (!stats.is_finished()) {
 //			std::cerr << "======== Game " << stats.step() << " ========" << std::endl;
 			black.open_episode("~:" + white.name());
 			white.open_episode(black.name() + ":~");
 
 			stats.open_episode(black.name() + ":" + white.name());
-			episode& game = stats.back();
-			while (true) {
-				agent& who = game.take_turns(black, white);
-				action move = who.take_action(game.state());
-//				std::cerr << game.state() << "#" << game.step() << " " << who.name() << ": " << move << std::endl;
-				if (game.apply_action(move) != true) break;
-				if (who.check_for_win(game.state())) break;
-			}
-			agent& win = game.last_turns(black, white);
-			stats.close_episode(win.name());
+			std::string win = play(black, white, stats.back());
+			stats.close_episode(win);
 
-			black.close_episode(win.name());
-			white.close_episode(win.name());
+			allocation::phase scope("learn");
+			black.close_episode(win);
+			white.close_episode(win);
 		}
+	} else if (!shell) { // launch local games on several workers, each with its own pair of players
+		std::mutex lock;
+		size_t started = stats.step();
+		pool.run([&](size_t id) {
+			// each side has a stream of its own, so that the two sides of a worker do not play the same rollouts
+			player black("name=black " + black_args + " role=black stream=" + std::to_string(2 * id));
+			player white("name=white " + white_args + " role=white stream=" + std::to_string(2 * id + 1));
+			black.pin(pool, id);
+			white.pin(pool, id);
+			while (true) {
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (started >= stats.total_episodes()) break;
+					started++;
+				}
+				black.open_episode("~:" + white.name());
+				white.open_episode(black.name() + ":~");
+
+				episode game;
+				game.open_episode(black.name() + ":" + white.name());
+				std::string win = play(black, white, game);
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					stats.append_episode(std::move(game), win);
+				}
+
+				allocation::phase scope("learn");
+				black.close_episode(win);
+				white.close_episode(win);
+			}
+		});
 	} else { // launch GTP shell
+		pool.pin(0);
+		auto open_game = [&]() {
+			if (!stats.is_episode_ongoing()) { // should open an episode
+				black.open_episode("~:" + white.name());
+				white.open_episode(black.name() + ":~");
+				stats.open_episode(black.name() + ":" + white.name());
+			}
+		};
+		auto close_game = [&]() {
+			if (stats.is_episode_ongoing()) { // should close an opened episode
+				agent& win = stats.back().last_turns(black, white);
+				stats.close_episode(win.name());
+				black.close_episode(win.name());
+				white.close_episode(win.name());
+			}
+		};
+		auto setup_game = [&](const std::vector<action::place>& moves) -> bool { // start a new game from the moves
+			board test;
+			for (const action::place& move : moves) {
+				if (move.apply(test) != board::legal) return false;
+			}
+			close_game();
+			open_game();
+			for (const action::place& move : moves) stats.back().apply_action(move);
+			return true;
+		};
+		// record the commands and the first lines of the replies with the microseconds since the shell started, e.g.,
+		//   > 1520344 genmove b
+		//   < 1770812 = E5
+		// so that the session can be fed to another build by replay
+		std::ofstream record;
+		if (record_path.size()) record.open(record_path, std::ios::out | std::ios::trunc);
+		auto session_start = std::chrono::steady_clock::now();
+		auto log = [&](char dir, const std::string& text) {
+			if (!record.is_open()) return;
+			auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - session_start);
+			record << dir << ' ' << now.count() << ' ' << text.substr(0, text.find('\n')) << std::endl;
+		};
+		auto answer = [&](bool success, const std::string& reply) {
+			std::cout << (success ? "= " : "? ") << reply << std::endl << std::endl;
+			log('<', (success ? "= " : "? ") + reply);
+		};
 		for (std::string command; std::getline(std::cin, command); ) {
-			if (command.back() == '\r') command.pop_back();
+			allocation::phase scope("gtp");
+			if (command.size() && command.back() == '\r') command.pop_back();
 			if (command.empty()) continue;
+			log('>', command);
 
 			std::vector<std::string> args;
 			std::istringstream iss(command);
 			for (std::string s; getline(iss, s, ' '); args.push_back(s));
 
 			std::string reply;
+			bool success = true;
 			if (args[0] == "play" || args[0] == "genmove") { // play a move, or generate a move and play
-				if (!stats.is_episode_ongoing()) { // should open an episode
-					black.open_episode("~:" + white.name());
-					white.open_episode(black.name() + ":~");
-					stats.open_episode(black.name() + ":" + white.name());
-				}
+				open_game();
 
 				episode& game = stats.back();
 				agent& who = game.take_turns(black, white);
 				if (who.role()[0] != std::tolower(args[1][0])) { // player mismatch?!
-					std::cout << "= " << "resign" << std::endl << std::endl;
+					answer(true, "resign");
 					// show the error message and terminate the shell
 					std::cerr << "player color " << args[1] << " mismatch!" << std::endl;
 					std::cerr << "current state, "
@@ -124,7 +223,7 @@ int main(int argc, const char* argv[]) {
 					std::string types = "?bw"; // black == 1, white == 2
 					action::place move(args[2], types.find(who.role()[0]));
 					if (game.apply_action(move) != true) { // remote plays an illegal move?!
-						std::cout << "= " << "resign" << std::endl << std::endl;
+						answer(true, "resign");
 						// show the error message and terminate the shell
 						std::cerr << who.role() << " plays an illegal action!" << std::endl;
 						const char* reason[] = {
@@ -144,6 +243,7 @@ int main(int argc, const char* argv[]) {
 						break;
 					}
 				} else if (args[0] == "genmove") { // generate a move and play
+					allocation::phase scope("search");
 					action::place move = who.take_action(game.state());
 					if (game.apply_action(move) == true) {
 						reply = move.position();
@@ -153,14 +253,46 @@ int main(int argc, const char* argv[]) {
 				}
 
 			} else if (args[0] == "clear_board" || args[0] == "quit") { // reset game, or quit
-				if (stats.is_episode_ongoing()) { // should close an opened episode
-					agent& win = stats.back().last_turns(black, white);
-					stats.close_episode(win.name());
-					black.close_episode(win.name());
-					white.close_episode(win.name());
-				}
+				close_game();
 				if (args[0] == "quit") break; // quit GTP shell
 
+			} else if (args[0] == "undo") { // take back the last move, the players keep what they have learned
+				if (!stats.is_episode_ongoing() || !stats.back().undo_action()) {
+					reply = "cannot undo";
+					success = false;
+				}
+
+			} else if (args[0] == "tcg-setup") { // start a new game from the given moves, played in turn from black
+				std::vector<action::place> moves;
+				for (size_t i = 1; i < args.size(); i++) {
+					if (args[i].empty()) continue;
+					moves.emplace_back(board::point(args[i]), moves.size() % 2 ? board::white : board::black);
+				}
+				if (!setup_game(moves)) {
+					reply = "illegal move";
+					success = false;
+				}
+
+			} else if (args[0] == "loadsgf") { // start a new game from an SGF file, up to but not including the given move number
+				std::string number = args.size() > 2 ? args[2] : "";
+				bool valid = number.size() <= 9 && number.find_first_not_of("0123456789") == std::string::npos;
+				std::ifstream in(args.size() > 1 ? args[1] : "");
+				std::string sgf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+				std::vector<action::place> moves = episode::parse_moves(sgf, valid && number.size() ? std::stoul(number) : -1);
+				if (!valid) { // the move number is not a number
+					reply = "syntax error";
+					success = false;
+				} else if (!in.is_open()) {
+					reply = "cannot load file";
+					success = false;
+				} else if (!episode::plain_moves(sgf)) { // the setup stones and passes cannot be replayed as moves
+					reply = "cannot load setup stones or passes";
+					success = false;
+				} else if (!setup_game(moves)) {
+					reply = "illegal move";
+					success = false;
+				}
+
 			} else if (args[0] == "showboard") { // print the board
 				std::stringstream buf;
 				buf << (stats.is_episode_ongoing() ? stats.back().state() : board());
@@ -181,16 +313,19 @@ int main(int argc, const char* argv[]) {
 			} else if (args[0] == "protocol_version") { // report GTP protocol version
 				reply = "2";
 			} else if (args[0] == "list_commands") { // print supported commands
-				reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n"
+				reply = "play\n" "genmove\n" "clear_board\n" "undo\n" "loadsgf\n" "tcg-setup\n" "showboard\n" "boardsize\n"
 				        "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit\n";
 			} else {
 				reply = "unknown command";
+				success = false;
 			}
 
-			std::cout << "= " << reply << std::endl << std::endl;
+			answer(success, reply);
 		}
 	}
 
+	allocation::report(shell ? std::cerr : std::cout, true); // keep the GTP replies clean
+
 	if (save_path.size()) {
 		std::ofstream out(save_path, std::ios::out | std::ios::trunc);
 		out << stats;
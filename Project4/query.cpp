@@ -0,0 +1,181 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * query.cpp: Parallel analytics over the episodes saved by --save
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <algorithm>
+#include "board.h"
+#include "action.h"
+#include "episode.h"
+#include "archive.h"
+#include "threads.h"
+
+/**
+ * the aggregations over the selected episodes, one per worker, merged at the end
+ */
+struct summary {
+	typedef std::pair<size_t, size_t> games_wins;
+	size_t episodes = 0;
+	size_t black_wins = 0;
+	std::map<std::string, games_wins> players; // name -> games, wins
+	std::map<std::string, games_wins> openings; // the first move -> games, black wins
+	std::map<size_t, games_wins> blocks; // block -> games, black wins
+	std::map<size_t, size_t> lengths; // bin -> games
+	std::array<size_t, board::size_x * board::size_y> moves = {};
+	std::array<std::vector<time_t>, 2> times; // black, white
+
+	void add(size_t index, const episode& ep, size_t block, size_t bin) {
+		std::string names = ep.open_tag();
+		std::string black = names.substr(0, names.find(':')), white = names.substr(names.find(':') + 1);
+		bool black_win = names.find(ep.close_tag()) == 0; // the same rule as the SGF output
+		std::vector<action> actions = ep.actions();
+		episodes++;
+		black_wins += black_win;
+		players[black].first++;
+		players[black].second += black_win;
+		players[white].first++;
+		players[white].second += !black_win;
+		if (actions.size()) {
+			games_wins& open = openings[board::point(action::place(actions[0]).position())];
+			open.first++;
+			open.second += black_win;
+		}
+		blocks[index / block].first++;
+		blocks[index / block].second += black_win;
+		lengths[actions.size() / bin]++;
+		for (const action& a : actions) {
+			int i = action::place(a).position().i;
+			if (i >= 0 && i < int(moves.size())) moves[i]++;
+		}
+		std::vector<time_t> t = ep.times();
+		for (size_t i = 0; i < t.size(); i++) times[i % 2].push_back(t[i]);
+	}
+
+	void merge(const summary& s) {
+		episodes += s.episodes;
+		black_wins += s.black_wins;
+		for (const auto& p : s.players)  players[p.first].first += p.second.first,  players[p.first].second += p.second.second;
+		for (const auto& p : s.openings) openings[p.first].first += p.second.first, openings[p.first].second += p.second.second;
+		for (const auto& p : s.blocks)   blocks[p.first].first += p.second.first,   blocks[p.first].second += p.second.second;
+		for (const auto& p : s.lengths)  lengths[p.first] += p.second;
+		for (size_t i = 0; i < moves.size(); i++) moves[i] += s.moves[i];
+		for (size_t c = 0; c < 2; c++) times[c].insert(times[c].end(), s.times[c].begin(), s.times[c].end());
+	}
+};
+
+int main(int argc, const char* argv[]) {
+	std::cerr << "HollowNoGo-Query: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cerr, " "));
+	std::cerr << std::endl << std::endl;
+
+	std::string archive_path, json_path, tag;
+	size_t first = 1, last = -1, block = 1000, bin = 5;
+	std::string threads = "auto", affinity, numa; // for worker threads
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto match_arg = [&](std::string flag) -> bool {
+			auto it = arg.find_first_not_of('-');
+			return arg.find(flag, it) == it;
+		};
+		auto next_opt = [&]() -> std::string {
+			auto it = arg.find('=') + 1;
+			return it ? arg.substr(it) : argv[++i];
+		};
+		if (match_arg("archive") || match_arg("load")) {
+			archive_path = next_opt();
+		} else if (match_arg("json")) {
+			json_path = next_opt();
+		} else if (match_arg("range")) { // the episodes from A to B (1-based), e.g., "1001-2000" or "5000-"
+			std::string range = next_opt();
+			first = std::stoull(range);
+			if (range.find('-') == std::string::npos) last = first;
+			else if (range.back() != '-') last = std::stoull(range.substr(range.find('-') + 1));
+		} else if (match_arg("tag")) { // the episodes whose players contain this text
+			tag = next_opt();
+		} else if (match_arg("block")) {
+			block = std::max<size_t>(std::stoull(next_opt()), 1);
+		} else if (match_arg("bin")) {
+			bin = std::max<size_t>(std::stoull(next_opt()), 1);
+		} else if (match_arg("threads")) {
+			threads = next_opt();
+		} else if (match_arg("affinity")) {
+			affinity = next_opt();
+		} else if (match_arg("numa")) {
+			numa = next_opt();
+		}
+	}
+
+	workers pool(threads, affinity, numa);
+	archive records(archive_path);
+	std::vector<summary> parts(pool.size());
+	records.scan(pool, [&](size_t id, size_t index, const std::string& line) {
+		if (index + 1 < first || index + 1 > last) return;
+		episode ep;
+		if (!(std::stringstream(line) >> ep)) return;
+		if (tag.size() && ep.open_tag().find(tag) == std::string::npos) return;
+		parts[id].add(index, ep, block, bin);
+	});
+	summary all;
+	for (const summary& s : parts) all.merge(s);
+
+	std::ofstream file;
+	if (json_path.size()) file.open(json_path, std::ios::out | std::ios::trunc);
+	std::ostream& out = json_path.size() ? file : std::cout;
+	auto quote = [](const std::string& text) {
+		std::string q = "\"";
+		for (char c : text) q += (c == '"' || c == '\\') ? std::string("\\") + c : std::string(1, c);
+		return q + "\"";
+	};
+	auto rate = [](size_t n, size_t d) { return d ? double(n) / d : 0.0; };
+	auto percentiles = [](std::vector<time_t>& t) {
+		std::stringstream ss;
+		std::sort(t.begin(), t.end());
+		auto at = [&](double p) { return t.size() ? t[std::min(t.size() - 1, size_t(p * t.size()))] : 0; };
+		double mean = 0;
+		for (time_t v : t) mean += v;
+		ss << "{\"moves\":" << t.size() << ",\"mean\":" << (t.size() ? mean / t.size() : 0) << ",\"p50\":" << at(0.5)
+		   << ",\"p90\":" << at(0.9) << ",\"p99\":" << at(0.99) << ",\"max\":" << (t.size() ? t.back() : 0) << "}";
+		return ss.str();
+	};
+
+	out << "{\"archive\":" << quote(archive_path) << ",\"episodes\":" << all.episodes;
+	out << ",\"win_rate\":{\"black\":" << rate(all.black_wins, all.episodes)
+	    << ",\"white\":" << rate(all.episodes - all.black_wins, all.episodes) << "}";
+	out << ",\"players\":{";
+	for (auto it = all.players.begin(); it != all.players.end(); it++) {
+		out << (it != all.players.begin() ? "," : "") << quote(it->first) << ":{\"games\":" << it->second.first
+		    << ",\"win_rate\":" << rate(it->second.second, it->second.first) << "}";
+	}
+	out << "},\"openings\":{";
+	for (auto it = all.openings.begin(); it != all.openings.end(); it++) {
+		out << (it != all.openings.begin() ? "," : "") << quote(it->first) << ":{\"games\":" << it->second.first
+		    << ",\"black_win_rate\":" << rate(it->second.second, it->second.first) << "}";
+	}
+	out << "},\"blocks\":[";
+	for (auto it = all.blocks.begin(); it != all.blocks.end(); it++) {
+		out << (it != all.blocks.begin() ? "," : "") << "{\"from\":" << (it->first * block + 1) << ",\"games\":" << it->second.first
+		    << ",\"black_win_rate\":" << rate(it->second.second, it->second.first) << "}";
+	}
+	out << "],\"lengths\":[";
+	for (auto it = all.lengths.begin(); it != all.lengths.end(); it++) {
+		out << (it != all.lengths.begin() ? "," : "") << "{\"from\":" << (it->first * bin) << ",\"games\":" << it->second << "}";
+	}
+	out << "],\"moves\":{";
+	for (size_t i = 0, n = 0; i < all.moves.size(); i++) {
+		if (all.moves[i]) out << (n++ ? "," : "") << quote(board::point(i)) << ":" << all.moves[i];
+	}
+	out << "},\"time\":{\"black\":" << percentiles(all.times[0]) << ",\"white\":" << percentiles(all.times[1]) << "}}" << std::endl;
+	return 0;
+}
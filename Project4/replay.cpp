@@ -0,0 +1,236 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * replay.cpp: Replay of recorded GTP sessions against an engine, measuring the response latency
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <csignal>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/**
+ * a session recorded by "nogo --shell --record=path", where each command is followed by the first line of its reply,
+ *   > 1520344 genmove b
+ *   < 1770812 = E5
+ * with the microseconds since the shell started
+ */
+struct session {
+	struct entry {
+		long long time;
+		std::string command;
+		std::string reply;
+	};
+	std::string path;
+	std::vector<entry> entries;
+
+	session(const std::string& path) : path(path) {
+		std::ifstream in(path);
+		if (!in.is_open()) throw std::invalid_argument("cannot open session: " + path);
+		for (std::string line; std::getline(in, line); ) {
+			std::istringstream iss(line);
+			char dir;
+			long long time;
+			if (!(iss >> dir >> time)) continue;
+			std::string text;
+			std::getline(iss >> std::ws, text);
+			if (dir == '>') entries.push_back({ time, text, "" });
+			else if (dir == '<' && entries.size()) entries.back().reply = text;
+		}
+	}
+};
+
+/**
+ * an engine process started by /bin/sh -c, talking GTP through its stdin and stdout
+ */
+class engine {
+public:
+	engine(const std::string& command) : pid(-1), in(nullptr), out(nullptr) {
+		int down[2], up[2];
+		if (pipe(down) != 0 || pipe(up) != 0) throw std::runtime_error("cannot create pipes");
+		pid = fork();
+		if (pid < 0) throw std::runtime_error("cannot fork");
+		if (pid == 0) {
+			dup2(down[0], STDIN_FILENO);
+			dup2(up[1], STDOUT_FILENO);
+			close(down[0]); close(down[1]);
+			close(up[0]); close(up[1]);
+			execl("/bin/sh", "sh", "-c", command.c_str(), (char*) nullptr);
+			_exit(127);
+		}
+		close(down[0]);
+		close(up[1]);
+		in = fdopen(down[1], "w");
+		out = fdopen(up[0], "r");
+	}
+	engine(const engine&) = delete;
+	engine& operator =(const engine&) = delete;
+	~engine() {
+		if (in) fclose(in);
+		if (out) fclose(out);
+		if (pid > 0) waitpid(pid, nullptr, 0);
+	}
+
+public:
+	bool send(const std::string& command) {
+		if (!in) return false;
+		return std::fprintf(in, "%s\n", command.c_str()) > 0 && std::fflush(in) == 0;
+	}
+
+	/**
+	 * read a reply, i.e., the lines from one starting with '=' or '?' until an empty line,
+	 * skipping anything else printed before it (e.g., the banner of nogo), returning false if the engine has exited
+	 */
+	bool receive(std::string& reply) {
+		reply.clear();
+		for (std::string line; read_line(line); ) {
+			if (line.size() && line.back() == '\r') line.pop_back();
+			if (reply.empty() && (line.empty() || (line[0] != '=' && line[0] != '?'))) continue;
+			if (line.empty()) return true;
+			reply += (reply.size() ? "\n" : "") + line;
+		}
+		return false;
+	}
+
+	/**
+	 * close the input of the engine, and wait until it exits
+	 */
+	void finish() {
+		if (in) fclose(in);
+		in = nullptr;
+		for (std::string line; read_line(line); );
+	}
+
+protected:
+	bool read_line(std::string& line) {
+		line.clear();
+		for (int ch; (ch = std::fgetc(out)) != EOF; ) {
+			if (ch == '\n') return true;
+			line += char(ch);
+		}
+		return line.size();
+	}
+
+private:
+	pid_t pid;
+	FILE* in;
+	FILE* out;
+};
+
+int main(int argc, const char* argv[]) {
+	std::cerr << "HollowNoGo-Replay: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cerr, " "));
+	std::cerr << std::endl << std::endl;
+
+	std::vector<std::string> paths;
+	std::string command = "./nogo --shell";
+	double pace = 1; // the speed relative to the recorded one, or 0 to send each command as soon as the last is answered
+	double limit = 1000; // the time limit of genmove in milliseconds
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto match_arg = [&](std::string flag) -> bool {
+			auto it = arg.find_first_not_of('-');
+			return arg.find(flag, it) == it;
+		};
+		auto next_opt = [&]() -> std::string {
+			auto it = arg.find('=') + 1;
+			return it ? arg.substr(it) : argv[++i];
+		};
+		if (match_arg("session")) {
+			paths.push_back(next_opt());
+		} else if (match_arg("engine")) {
+			command = next_opt();
+		} else if (match_arg("pace")) {
+			pace = std::stod(next_opt());
+		} else if (match_arg("limit")) {
+			limit = std::stod(next_opt());
+		}
+	}
+	if (paths.empty()) throw std::invalid_argument("no session to replay");
+	std::signal(SIGPIPE, SIG_IGN);
+
+	typedef std::chrono::steady_clock clock;
+	std::map<std::string, std::vector<double>> latency; // the milliseconds of each command name
+	size_t violations = 0, divergences = 0, failures = 0;
+	for (const std::string& path : paths) {
+		session rec(path);
+		engine gtp(command);
+		auto start = clock::now();
+		size_t diverged = 0; // the index of the first genmove which differs, plus one
+		for (size_t n = 0; n < rec.entries.size(); n++) {
+			const session::entry& e = rec.entries[n];
+			if (pace > 0) std::this_thread::sleep_until(start + std::chrono::microseconds(static_cast<long long>(e.time / pace)));
+			std::string name = e.command.substr(0, e.command.find(' '));
+			if (name == "quit") break;
+
+			auto sent = clock::now();
+			std::string reply;
+			if (!gtp.send(e.command) || !gtp.receive(reply)) {
+				std::cout << path << ": engine exited at command " << (n + 1) << " (" << e.command << ")" << std::endl;
+				failures++;
+				break;
+			}
+			double ms = std::chrono::duration<double, std::milli>(clock::now() - sent).count();
+			latency[name].push_back(ms);
+
+			if (name != "genmove") continue;
+			if (ms > limit) {
+				std::cout << path << ": " << e.command << " at command " << (n + 1) << " took " << ms << "ms" << std::endl;
+				violations++;
+			}
+			reply = reply.substr(0, reply.find('\n'));
+			if (e.reply.empty() || reply == e.reply) continue;
+			if (!diverged) {
+				std::cout << path << ": diverged at command " << (n + 1) << " (" << e.command << "), "
+				          << "recorded \"" << e.reply << "\" but replied \"" << reply << "\"" << std::endl;
+				diverged = n + 1;
+				divergences++;
+			}
+
+			// resync the engine to the recorded move, so that the following commands are in the recorded positions
+			// the resync commands are not timed, and a resign means that no move has been played
+			std::string color = e.command.substr(e.command.find(' ') + 1);
+			std::vector<std::string> resync;
+			if (reply != "= resign") resync.push_back("undo");
+			if (e.reply != "= resign") resync.push_back("play " + color + " " + e.reply.substr(2));
+			bool synced = true;
+			for (const std::string& cmd : resync) {
+				std::string ack;
+				if (!gtp.send(cmd) || !gtp.receive(ack) || ack[0] != '=') synced = false;
+				if (!synced) break;
+			}
+			if (!synced) {
+				std::cout << path << ": cannot resync at command " << (n + 1) << " (" << e.command << ")" << std::endl;
+				failures++;
+				break;
+			}
+		}
+		gtp.finish();
+	}
+	std::cout << std::endl;
+
+	std::cout << "sessions = " << paths.size() << ", pace = " << pace << ", limit = " << limit << "ms" << std::endl;
+	std::cout << "\t" "command" "\t" "count" "\t" "p50" "\t" "p99" "\t" "max" << std::endl;
+	for (auto& it : latency) {
+		std::vector<double>& ms = it.second;
+		std::sort(ms.begin(), ms.end());
+		auto rank = [&](double q) { return ms[std::min<size_t>(q * ms.size(), ms.size() - 1)]; };
+		std::cout << "\t" << it.first << "\t" << ms.size() << "\t" << rank(0.5) << "\t" << rank(0.99) << "\t" << ms.back() << std::endl;
+	}
+	std::cout << "violations = " << violations << ", divergences = " << divergences << ", failures = " << failures << std::endl;
+	return violations || failures ? 1 : 0;
+}
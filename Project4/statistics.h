@@ -16,6 +16,12 @@
 #include "action.h"
 #include "episode.h"
 
+/**
+ * print the heap allocations since the last report, a weak hook which is null unless alloc.h is linked in
+ * only the file with main() includes alloc.h, since it replaces the global operator new and delete
+ */
+void report_allocations(std::ostream& out) __attribute__((weak));
+
 class statistics {
 public:
 	/**
@@ -76,6 +82,7 @@ public:
 		          <<     " (" << (Bop * 1000.0 / Bdu)
 		          <<      "|" << (Wop * 1000.0 / Wdu) << ")";
 		std::cout << std::endl;
+		if (report_allocations) report_allocations(std::cout);
 	}
 
 	void summary() const {
@@ -101,6 +108,15 @@ public:
 		if (count % block == 0) show();
 	}
 
+	/**
+	 * append an episode which has been played elsewhere, e.g., by another worker thread
+	 */
+	void append_episode(episode&& ep, const std::string& flag = "") {
+		if (count++ >= limit) data.pop_front();
+		data.push_back(std::move(ep));
+		close_episode(flag);
+	}
+
 	episode& at(size_t i) {
 		return data.at(i);
 	}
@@ -113,6 +129,9 @@ public:
 	size_t step() const {
 		return count;
 	}
+	size_t total_episodes() const {
+		return total;
+	}
 
 	friend std::ostream& operator <<(std::ostream& out, const statistics& stat) {
 		for (const episode& rec : stat.data) out << rec << std::endl;
@@ -0,0 +1,189 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * suite.cpp: Tactical test suite measuring the time-to-solution of the player
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "threads.h"
+
+/**
+ * a position of the suite, and the moves which are accepted as its solution
+ */
+struct problem {
+	std::string name;
+	board state;
+	std::vector<int> solutions;
+
+	/**
+	 * a search of the player with a time budget
+	 */
+	struct run {
+		size_t budget;
+		std::string move;
+		bool correct;
+		double time;
+		float playouts;
+	};
+	std::vector<run> runs;
+
+	/**
+	 * the first run from which the player settles on a correct move, i.e., the runs with larger budgets are all correct
+	 * return runs.size() if it never settles
+	 */
+	size_t settled() const {
+		size_t first = runs.size();
+		for (size_t i = runs.size(); i > 0 && runs[i - 1].correct; i--) first = i - 1;
+		return first;
+	}
+};
+
+/**
+ * load a suite, each line of which is an SGF file or an inline SGF record, followed by the accepted moves, e.g.,
+ *   problems/ladder.sgf E5 F4
+ *   (;FF[4]SZ[9];B[ee];W[cc]) D4
+ * the position is the end of the record, and the lines starting with '#' are ignored
+ */
+std::vector<problem> load_suite(const std::string& path) {
+	std::vector<problem> suite;
+	std::ifstream in(path);
+	if (!in.is_open()) throw std::runtime_error("cannot open suite " + path);
+	for (std::string line; std::getline(in, line); ) {
+		if (line.empty() || line[0] == '#') continue;
+		problem p;
+		std::string sgf, rest;
+		if (line[0] == '(') {
+			sgf = line.substr(0, line.find(')') + 1);
+			rest = line.substr(sgf.size());
+			p.name = "#" + std::to_string(suite.size() + 1);
+		} else {
+			p.name = line.substr(0, line.find(' '));
+			rest = line.substr(p.name.size());
+			std::ifstream file(p.name);
+			if (!file.is_open()) throw std::runtime_error("cannot open " + p.name);
+			sgf.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+		if (!episode::plain_moves(sgf)) throw std::runtime_error("setup stones or passes in " + p.name);
+		for (const action::place& move : episode::parse_moves(sgf)) {
+			if (move.apply(p.state) != board::legal) throw std::runtime_error("illegal move in " + p.name);
+		}
+		std::stringstream ss(rest);
+		for (std::string move; ss >> move; ) p.solutions.push_back(board::point(move).i);
+		if (p.solutions.empty()) throw std::runtime_error("no solution for " + p.name);
+		suite.push_back(p);
+	}
+	return suite;
+}
+
+int main(int argc, const char* argv[]) {
+	std::cerr << "HollowNoGo-Suite: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cerr, " "));
+	std::cerr << std::endl << std::endl;
+
+	std::string suite_path, player_args, json_path;
+	std::string budget_list = "10,20,50,100,200,500,1000"; // in milliseconds
+	std::string affinity;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto match_arg = [&](std::string flag) -> bool {
+			auto it = arg.find_first_not_of('-');
+			return arg.find(flag, it) == it;
+		};
+		auto next_opt = [&]() -> std::string {
+			auto it = arg.find('=') + 1;
+			return it ? arg.substr(it) : argv[++i];
+		};
+		if (match_arg("suite")) {
+			suite_path = next_opt();
+		} else if (match_arg("player")) {
+			player_args = next_opt();
+		} else if (match_arg("budgets")) {
+			budget_list = next_opt();
+		} else if (match_arg("json")) {
+			json_path = next_opt();
+		} else if (match_arg("affinity")) {
+			affinity = next_opt();
+		}
+	}
+
+	std::vector<size_t> budgets;
+	for (int ms : workers::parse_list(budget_list)) budgets.push_back(ms);
+	std::sort(budgets.begin(), budgets.end());
+	budgets.erase(std::unique(budgets.begin(), budgets.end()), budgets.end());
+	std::vector<problem> suite = load_suite(suite_path);
+	workers("1", affinity).pin(0);
+
+	for (problem& p : suite) {
+		std::string role = p.state.info().who_take_turns == board::black ? "black" : "white";
+		for (size_t budget : budgets) {
+			player engine(player_args + " role=" + role + " timeout=" + std::to_string(budget));
+			engine.open_episode();
+			auto start = std::chrono::steady_clock::now();
+			action::place move = engine.take_action(p.state);
+			std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+			bool correct = std::find(p.solutions.begin(), p.solutions.end(), move.position().i) != p.solutions.end();
+			p.runs.push_back({ budget, board::point(move.position()), correct, time.count(), engine.searched() });
+		}
+		size_t at = p.settled();
+		std::cerr << p.name << ": " << (at < budgets.size() ? "solved at " + std::to_string(budgets[at]) + "ms" : "unsolved") << std::endl;
+	}
+
+	std::ofstream file;
+	if (json_path.size()) file.open(json_path, std::ios::out | std::ios::trunc);
+	std::ostream& out = json_path.size() ? file : std::cout;
+	auto quote = [](const std::string& text) {
+		std::string q = "\"";
+		for (char c : text) q += (c == '"' || c == '\\') ? std::string("\\") + c : std::string(1, c);
+		return q + "\"";
+	};
+	out << "{\"player\":" << quote(player_args) << ",\"positions\":[";
+	for (size_t i = 0; i < suite.size(); i++) {
+		const problem& p = suite[i];
+		out << (i ? "," : "") << "{\"name\":" << quote(p.name) << ",\"solutions\":[";
+		for (size_t j = 0; j < p.solutions.size(); j++) out << (j ? "," : "") << quote(board::point(p.solutions[j]));
+		out << "],\"runs\":[";
+		for (size_t j = 0; j < p.runs.size(); j++) {
+			const problem::run& r = p.runs[j];
+			out << (j ? "," : "") << "{\"budget\":" << r.budget << ",\"move\":" << quote(r.move) << ",\"correct\":"
+			    << (r.correct ? "true" : "false") << ",\"time\":" << r.time << ",\"playouts\":" << r.playouts << "}";
+		}
+		out << "],\"solved\":";
+		size_t at = p.settled();
+		if (at < p.runs.size()) {
+			out << "{\"budget\":" << p.runs[at].budget << ",\"time\":" << p.runs[at].time << ",\"playouts\":" << p.runs[at].playouts << "}";
+		} else {
+			out << "null";
+		}
+		out << "}";
+	}
+	out << "],\"curve\":[";
+	for (size_t b = 0; b < budgets.size(); b++) { // the positions settled within each budget, and the positions answered correctly
+		size_t solved = 0, correct = 0;
+		double time = 0;
+		for (const problem& p : suite) {
+			solved += p.settled() <= b;
+			correct += p.runs[b].correct;
+			time += p.runs[b].time;
+		}
+		out << (b ? "," : "") << "{\"budget\":" << budgets[b] << ",\"time\":" << (suite.size() ? time / suite.size() : 0)
+		    << ",\"solved\":" << solved << ",\"correct\":" << correct
+		    << ",\"rate\":" << (suite.size() ? double(solved) / suite.size() : 0) << "}";
+	}
+	out << "]}" << std::endl;
+	return 0;
+}
@@ -0,0 +1,200 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * tune.cpp: SPSA tuning of the player options by parallel matches
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <random>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "threads.h"
+
+/**
+ * a tuned option of the player, e.g., "c=1.4:0.1:3:0.2" for c starting at 1.4 within [0.1, 3], perturbed by 0.2
+ * the option is an integer if all of them are
+ */
+struct parameter {
+	std::string name;
+	double value, min, max, step;
+	bool integer;
+
+	parameter(const std::string& spec) {
+		name = spec.substr(0, spec.find('='));
+		std::string text = spec.substr(spec.find('=') + 1);
+		for (char& ch : text) if (ch == ':') ch = ' ';
+		std::stringstream ss(text);
+		if (!(ss >> value >> min >> max >> step) || min > max || step <= 0)
+			throw std::invalid_argument("invalid parameter: " + spec);
+		integer = text.find_first_of(".eE") == std::string::npos;
+	}
+
+	/**
+	 * the value moved by (units) of step as the player gets it, i.e., within the range, and rounded if integer
+	 */
+	double applied(double units = 0) const {
+		double v = std::min(std::max(value + units * step, min), max);
+		return integer ? std::llround(v) : v;
+	}
+
+	/**
+	 * the option string of the value moved by (units) of step
+	 */
+	std::string option(double units = 0) const {
+		std::stringstream ss;
+		ss << name << "=" << applied(units);
+		return ss.str();
+	}
+};
+
+int main(int argc, const char* argv[]) {
+	std::cerr << "HollowNoGo-Tune: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cerr, " "));
+	std::cerr << std::endl << std::endl;
+
+	std::string params, base, checkpoint;
+	size_t iterations = 100, games = 16;
+	double rate = 1, stability = -1, alpha = 0.602, gamma = 0.101, perturb = 1; // the gains of SPSA, in units of step
+	std::string threads = "auto", affinity, numa; // for worker threads
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		auto match_arg = [&](std::string flag) -> bool {
+			auto it = arg.find_first_not_of('-');
+			return arg.find(flag, it) == it;
+		};
+		auto next_opt = [&]() -> std::string {
+			auto it = arg.find('=') + 1;
+			return it ? arg.substr(it) : argv[++i];
+		};
+		if (match_arg("params")) {
+			params = next_opt();
+		} else if (match_arg("base")) { // the fixed options of both players
+			base = next_opt();
+		} else if (match_arg("checkpoint")) {
+			checkpoint = next_opt();
+		} else if (match_arg("iterations")) {
+			iterations = std::stoull(next_opt());
+		} else if (match_arg("games")) { // the games per iteration, half of them with each color
+			games = std::max<size_t>(std::stoull(next_opt()) / 2 * 2, 2);
+		} else if (match_arg("rate")) {
+			rate = std::stod(next_opt());
+		} else if (match_arg("stability")) {
+			stability = std::stod(next_opt());
+		} else if (match_arg("perturb")) {
+			perturb = std::stod(next_opt());
+		} else if (match_arg("alpha")) {
+			alpha = std::stod(next_opt());
+		} else if (match_arg("gamma")) {
+			gamma = std::stod(next_opt());
+		} else if (match_arg("threads")) {
+			threads = next_opt();
+		} else if (match_arg("affinity")) {
+			affinity = next_opt();
+		} else if (match_arg("numa")) {
+			numa = next_opt();
+		}
+	}
+	if (stability < 0) stability = iterations / 10.0;
+
+	std::vector<parameter> theta;
+	std::stringstream specs(params);
+	for (std::string spec; specs >> spec; ) theta.emplace_back(spec);
+	if (theta.empty()) throw std::invalid_argument("no parameter to tune");
+
+	// resume from the checkpoint, which holds the iterations done and the current values, e.g., "iteration 12" and "c 1.52"
+	size_t first = 0;
+	if (checkpoint.size()) {
+		std::ifstream in(checkpoint);
+		for (std::string key; in >> key; ) {
+			if (key == "iteration") {
+				in >> first;
+				continue;
+			}
+			double value;
+			in >> value;
+			for (parameter& p : theta) if (p.name == key) p.value = value;
+		}
+		if (first) std::cerr << "resume from iteration " << first << std::endl;
+	}
+
+	workers pool(threads, affinity, numa);
+	for (size_t k = first; k < iterations; k++) {
+		std::default_random_engine engine(k); // the same perturbations whether resumed or not
+		double a = rate / std::pow(k + 1 + stability, alpha), c = perturb / std::pow(k + 1, gamma);
+		std::vector<int> delta(theta.size());
+		std::string plus = base, minus = base;
+		for (size_t i = 0; i < theta.size(); i++) {
+			delta[i] = engine() % 2 ? 1 : -1;
+			plus += " " + theta[i].option(+c * delta[i]);
+			minus += " " + theta[i].option(-c * delta[i]);
+		}
+
+		// the games between theta + c * delta and theta - c * delta, swapping colors every game
+		std::atomic<size_t> next(0), plus_wins(0);
+		pool.run([&](size_t id) {
+			for (size_t g; (g = next++) < games; ) {
+				// each side has a stream of its own, so that the rollouts of the two sides are not correlated
+				size_t stream = 2 * (k * games + g);
+				bool plus_black = g % 2 == 0;
+				player black("name=black " + (plus_black ? plus : minus) + " role=black stream=" + std::to_string(stream));
+				player white("name=white " + (plus_black ? minus : plus) + " role=white stream=" + std::to_string(stream + 1));
+				black.pin(pool, id);
+				white.pin(pool, id);
+				black.open_episode("~:" + white.name());
+				white.open_episode(black.name() + ":~");
+				episode game;
+				game.open_episode(black.name() + ":" + white.name());
+				while (true) {
+					agent& who = game.take_turns(black, white);
+					action move = who.take_action(game.state());
+					if (game.apply_action(move) != true) break;
+					if (who.check_for_win(game.state())) break;
+				}
+				bool black_win = &game.last_turns(black, white) == &black;
+				if (black_win == plus_black) plus_wins++;
+			}
+		});
+
+		double result = (2.0 * plus_wins - games) / games; // the score of plus minus that of minus, in [-1, 1]
+		for (size_t i = 0; i < theta.size(); i++) {
+			parameter& p = theta[i];
+			// the difference actually played in units of step, which is less than 2 * c near the range or after rounding
+			double diff = (p.applied(+c * delta[i]) - p.applied(-c * delta[i])) / p.step;
+			if (diff == 0) continue;
+			p.value += a * result / diff * p.step;
+			p.value = std::min(std::max(p.value, p.min), p.max);
+		}
+
+		std::cout << (k + 1) << "\t" << "plus = " << plus_wins << "/" << games;
+		for (const parameter& p : theta) std::cout << "\t" << p.name << " = " << p.value;
+		std::cout << std::endl;
+
+		if (checkpoint.size()) { // written aside first, so that an interrupted write never loses the last checkpoint
+			std::ofstream out(checkpoint + ".tmp", std::ios::out | std::ios::trunc);
+			out << "iteration " << (k + 1) << std::endl;
+			for (const parameter& p : theta) out << p.name << " " << p.value << std::endl;
+			out.close();
+			std::rename((checkpoint + ".tmp").c_str(), checkpoint.c_str());
+		}
+	}
+
+	std::cout << "tuned:";
+	for (const parameter& p : theta) std::cout << " " << p.option();
+	std::cout << std::endl;
+	return 0;
+}